@@ -0,0 +1,139 @@
+#include "cell_engine.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    constexpr std::size_t first_neighbors = 16; //doubled until the cell is proven complete
+}
+
+void clip_by_nearest(cell& c, const int index, const std::vector<point>& sites, const std::vector<double>& weights, const kd_tree& tree,
+                     const double max_weight, std::vector<int>& nearest, std::vector<int>& clipped)
+{
+    clipped.clear(); //sorted, clipping by the same neighbour twice would leave a zero length side
+    const point& site = sites[index];
+    const double site_weight = weights.empty() ? 0.0 : weights[index];
+    for (std::size_t k = first_neighbors;; k *= 2)
+    {
+        const std::size_t count = std::min(k, tree.size());
+        tree.nearest(site, count, nearest);
+        //closest first, they cut away the most. a bigger k gives the same ones first again, up to ties
+        const std::size_t before = clipped.size();
+        for (const int n : nearest)
+        {
+            if (n != index && !std::binary_search(clipped.begin(), clipped.begin() + before, n))
+            {
+                clip_cell(c, sites[n], n, weights.empty() ? 0.0 : weights[n] - site_weight);
+                clipped.push_back(n);
+            }
+        }
+        std::sort(clipped.begin(), clipped.end());
+        if (c.polygon.size() < 3 || count == tree.size())
+        {
+            return;
+        }
+        //every point of the cell is within radius of the site. a site at distance d >= reach can only take some of
+        //it if (d - radius)^2 - its weight < radius^2 - the site's weight
+        double radius_squared = 0.0;
+        for (const point& v : c.polygon)
+        {
+            radius_squared = std::max(radius_squared, (v.x - site.x) * (v.x - site.x) + (v.y - site.y) * (v.y - site.y));
+        }
+        const point& furthest = sites[nearest.back()];
+        const double reach = std::sqrt((furthest.x - site.x) * (furthest.x - site.x) + (furthest.y - site.y) * (furthest.y - site.y));
+        const double radius = std::sqrt(radius_squared);
+        if (reach >= radius && (reach - radius) * (reach - radius) >= radius_squared - site_weight + max_weight)
+        {
+            return;
+        }
+    }
+}
+
+std::vector<cell> compute_cells(const std::vector<point>& sites, const int width, const int height)
+{
+    std::vector<cell> cells;
+    compute_cells(sites, width, height, cells);
+    return cells;
+}
+
+void compute_cells(const std::vector<point>& sites, const int width, const int height, std::vector<cell>& cells)
+{
+    compute_cells(sites, std::vector<double>{}, width, height, cells);
+}
+
+void compute_cells(const std::vector<point>& sites, const std::vector<double>& weights, const int width, const int height, std::vector<cell>& cells)
+{
+    cells.resize(sites.size(), cell(point(0, 0)));
+    for (std::size_t i = 0; i < sites.size(); i++)
+    {
+        cells[i].site = sites[i];
+        cells[i].polygon.clear();
+        cells[i].neighbors.clear();
+    }
+
+    //like the sweep: sites outside the frame are skipped and of equal sites only the first one counts
+    std::vector<int> order(sites.size());
+    for (int i = 0; i < static_cast<int>(sites.size()); i++)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](const int a, const int b) {
+        return CompareByXY()(sites[a], sites[b]) || (!CompareByXY()(sites[b], sites[a]) && a < b);
+    });
+    std::vector<char> first(sites.size(), 0);
+    for (std::size_t k = 0; k < order.size(); k++)
+    {
+        first[order[k]] = k == 0 || CompareByXY()(sites[order[k - 1]], sites[order[k]]);
+    }
+    std::vector<int> used;
+    for (int i = 0; i < static_cast<int>(sites.size()); i++)
+    {
+        const point& site = sites[i];
+        if (first[i] && !(site.y > height+1 || site.x > width+1 || site.x < -1))
+        {
+            used.push_back(i);
+        }
+    }
+    if (used.size() < 2) //a lone site has no neighbour to make an edge with, the sweep gives it no cell either
+    {
+        return;
+    }
+    std::vector<point> tree_points;
+    std::vector<double> tree_weights;
+    tree_points.reserve(used.size());
+    double max_weight = weights.empty() ? 0.0 : -std::numeric_limits<double>::infinity();
+    for (const int i : used)
+    {
+        tree_points.push_back(sites[i]);
+        if (!weights.empty())
+        {
+            const double weight = static_cast<std::size_t>(i) < weights.size() ? weights[i] : 0.0;
+            tree_weights.push_back(weight);
+            max_weight = std::max(max_weight, weight);
+        }
+    }
+    const kd_tree tree(tree_points);
+
+    parallel_for(0, used.size(), [&](const std::size_t u) {
+        thread_local std::vector<int> nearest;
+        thread_local std::vector<int> clipped;
+        const int i = used[u];
+        cell& c = cells[i];
+        make_box_cell(c, width, height);
+        clip_by_nearest(c, static_cast<int>(u), tree_points, tree_weights, tree, max_weight, nearest, clipped);
+        if (c.polygon.size() < 3) //power cell that is empty or outside the frame
+        {
+            c.polygon.clear();
+            c.neighbors.clear();
+        }
+        for (int& neighbor : c.neighbors)
+        {
+            if (neighbor >= 0)
+            {
+                neighbor = used[neighbor];
+            }
+        }
+    }, 64);
+}
@@ -0,0 +1,22 @@
+#pragma once
+//voronoi cells built one site at a time instead of by the sweep. the cells do not depend on each other, so they are
+//built on all cores: every cell starts as the frame and is clipped by the bisectors of its nearest neighbours from a
+//kd-tree, more neighbours are fetched until the security radius shows that no site further away can cut it.
+
+#include "kd_tree.h"
+#include "utilities.h"
+
+#include <vector>
+
+//the same cells voronoi_diagram::build_cells gives after run_voronoi on these sites: one per site in input order, empty
+//for duplicates and for sites the sweep leaves out
+std::vector<cell> compute_cells(const std::vector<point>& sites, int width, int height);
+void compute_cells(const std::vector<point>& sites, int width, int height, std::vector<cell>& cells); //the same into cells, reusing their polygons
+//power cells, weights[i] is the weight of sites[i] like in voronoi_diagram. empty weights give the plain cells
+void compute_cells(const std::vector<point>& sites, const std::vector<double>& weights, int width, int height, std::vector<cell>& cells);
+
+//cuts c, the cell of sites[index] started as a box, down by the neighbours tree (built on sites) gives, nearest first,
+//until no site further away can take any of it. weights are those of sites or empty, max_weight is the largest of them
+//(0 without weights), nearest and clipped are scratch. the neighbours of c are indices into sites
+void clip_by_nearest(cell& c, int index, const std::vector<point>& sites, const std::vector<double>& weights, const kd_tree& tree,
+                     double max_weight, std::vector<int>& nearest, std::vector<int>& clipped);
@@ -0,0 +1,91 @@
+#include "diagram_batch.h"
+#include "task_pool.h"
+
+#include <exception>
+#include <iostream>
+
+namespace {
+    void collect_result(const voronoi_diagram& diagram, const diagram_options& options, diagram_result& result)
+    {
+        result.edges = diagram.get_diagram_edges();
+        result.vertices = diagram.get_vertices();
+        if (options.cells)
+        {
+            result.cells = diagram.build_cells();
+        }
+        result.ok = true;
+    }
+}
+
+std::vector<diagram_result> compute_diagrams(const std::vector<std::vector<point>>& site_sets, const diagram_options& options)
+{
+    std::vector<diagram_result> results(site_sets.size());
+    task_pool::shared().run(site_sets.size(), [&](const std::size_t i, unsigned) {
+        //kept by the thread from batch to batch, reset keeps its memory
+        thread_local voronoi_diagram engine(std::vector<point>{});
+        try
+        {
+            engine.set_frame(options.width, options.height);
+            engine.set_engine(options.engine);
+            engine.set_tracer(options.tracer);
+            engine.reset(site_sets[i]);
+            engine.run_voronoi();
+            collect_result(engine, options, results[i]);
+        }
+        catch (const std::exception& error)
+        {
+            //nothing may leave a pool worker, the job fails alone and keeps none of what it had collected
+            results[i] = diagram_result();
+            std::cerr << "Could not build diagram " << i << " of the batch: " << error.what() << std::endl;
+        }
+    });
+    return results;
+}
+
+std::future<diagram_result> compute_async(std::vector<point> sites, const diagram_options& options, std::function<void(const sweep_progress&)> progress, cancel_token cancel)
+{
+    return std::async(std::launch::async, [sites = std::move(sites), options, progress = std::move(progress), cancel]() mutable {
+        diagram_result result;
+        if (cancel.cancelled())
+        {
+            result.cancelled = true;
+            return result;
+        }
+        voronoi_diagram diagram(std::move(sites), options.width, options.height);
+        diagram.set_engine(options.engine);
+        diagram.set_tracer(options.tracer);
+        std::size_t reported = 0; //percent of the site events
+        try
+        {
+            const bool finished = diagram.run_voronoi([&](const sweep_progress& now) {
+                if (cancel.cancelled())
+                {
+                    return false;
+                }
+                const std::size_t percent = now.sites_total == 0 ? 100 : now.sites_done * 100 / now.sites_total;
+                if (progress && percent != reported)
+                {
+                    reported = percent;
+                    progress(now);
+                }
+                return true;
+            });
+            if (!finished)
+            {
+                result.cancelled = true;
+                return result;
+            }
+        }
+        catch (const std::exception& error)
+        {
+            std::cerr << "Could not build the diagram: " << error.what() << std::endl;
+            return result;
+        }
+        collect_result(diagram, options, result);
+        if (progress)
+        {
+            progress(diagram.get_progress());
+        }
+        return result;
+    });
+}
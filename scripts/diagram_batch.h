@@ -0,0 +1,47 @@
+#pragma once
+//diagrams built away from the caller. compute_diagrams builds many independent ones at once, e.g. one per tile: they
+//are jobs on the shared task_pool, every worker thread keeps one voronoi_diagram and resets it for each of its jobs,
+//so after the first few jobs only the results themselves allocate. compute_async builds one in the background,
+//reports how far it is and can be cancelled.
+
+#include "voronoi.h"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+struct diagram_options {
+    int width = 800;   //the frame every site set is in, [0,width] x [0,height]
+    int height = 600;
+    voronoi_engine engine = voronoi_engine::sweep;
+    bool cells = false; //also build the cells of every diagram
+    sweep_tracer* tracer = nullptr; //traces every diagram, each thread into its own ring (sweep_trace.h)
+};
+
+struct diagram_result {
+    bool ok = false;        //false when the sweep gave up on the sites (it has already said why on std::cerr) or was cancelled
+    bool cancelled = false; //compute_async stopped by its cancel_token
+    std::vector<edge> edges;
+    std::vector<point> vertices;
+    std::vector<cell> cells; //with diagram_options::cells, one per site in the order of the site set
+};
+
+//one result per site set, in the same order
+std::vector<diagram_result> compute_diagrams(const std::vector<std::vector<point>>& site_sets, const diagram_options& options = diagram_options());
+
+//copies share the flag, so the caller keeps one and hands one to compute_async
+class cancel_token {
+    private:
+        std::shared_ptr<std::atomic<bool>> flag = std::make_shared<std::atomic<bool>>(false);
+    public:
+        void cancel() const {flag->store(true, std::memory_order_relaxed);}
+        bool cancelled() const {return flag->load(std::memory_order_relaxed);}
+};
+
+//builds the diagram on a thread of its own. progress is called from that thread whenever another percent of the site
+//events is done, and once at the end. cancel is looked at between events, a cancelled run frees the diagram right
+//away and its result has cancelled set. like every std::async future, dropping it waits for the run to stop
+std::future<diagram_result> compute_async(std::vector<point> sites, const diagram_options& options = diagram_options(),
+                                          std::function<void(const sweep_progress&)> progress = nullptr, cancel_token cancel = cancel_token());
@@ -0,0 +1,244 @@
+#include "diagram_snapshot.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    std::uint64_t align8(const std::uint64_t offset)
+    {
+        return (offset + 7) & ~static_cast<std::uint64_t>(7);
+    }
+
+    template<typename T>
+    void write_section(std::ofstream& out, const std::vector<T>& values, const snapshot_section& section)
+    {
+        static const char padding[8] = {};
+        const std::uint64_t position = static_cast<std::uint64_t>(out.tellp());
+        out.write(padding, static_cast<std::streamsize>(section.offset - position));
+        if (!values.empty())
+        {
+            out.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+        }
+    }
+}
+
+bool write_snapshot(const voronoi_diagram& diagram, const std::string& path)
+{
+    const std::vector<point>& input_points = diagram.get_input_points();
+    const std::vector<edge>& diagram_edges = diagram.get_diagram_edges();
+
+    std::map<point, std::uint32_t, CompareByXY> site_index;
+    std::vector<snapshot_point> sites;
+    sites.reserve(input_points.size());
+    for (const point& p : input_points)
+    {
+        site_index.emplace(p, static_cast<std::uint32_t>(sites.size()));
+        sites.push_back({p.x, p.y});
+    }
+
+    std::vector<snapshot_point> vertices;
+    vertices.reserve(diagram.get_vertices().size());
+    for (const point& p : diagram.get_vertices())
+    {
+        vertices.push_back({p.x, p.y});
+    }
+
+    //edges, and how many edges border each cell
+    std::vector<snapshot_edge> edges;
+    edges.reserve(diagram_edges.size());
+    std::vector<std::uint32_t> cell_offsets(sites.size() + 1, 0);
+    for (const edge& e : diagram_edges)
+    {
+        const auto a = site_index.find(e.arc_sites.first);
+        const auto b = site_index.find(e.arc_sites.second);
+        snapshot_edge out{{e.start.x, e.start.y}, {e.end.x, e.end.y},
+                          a == site_index.end() ? snapshot_no_site : a->second,
+                          b == site_index.end() ? snapshot_no_site : b->second};
+        if (out.site_a != snapshot_no_site) cell_offsets[out.site_a + 1]++;
+        if (out.site_b != snapshot_no_site) cell_offsets[out.site_b + 1]++;
+        edges.push_back(out);
+    }
+    for (std::size_t i = 1; i < cell_offsets.size(); i++)
+    {
+        cell_offsets[i] += cell_offsets[i-1];
+    }
+
+    std::vector<std::uint32_t> cell_edges(cell_offsets.back());
+    std::vector<std::uint32_t> fill(cell_offsets.begin(), cell_offsets.end() - 1);
+    for (std::uint32_t i = 0; i < edges.size(); i++)
+    {
+        if (edges[i].site_a != snapshot_no_site) cell_edges[fill[edges[i].site_a]++] = i;
+        if (edges[i].site_b != snapshot_no_site) cell_edges[fill[edges[i].site_b]++] = i;
+    }
+
+    snapshot_header header{};
+    std::memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+    header.version = snapshot_version;
+    header.endian_tag = snapshot_endian_tag;
+    header.header_size = sizeof(snapshot_header);
+    header.width = diagram.get_display_w();
+    header.height = diagram.get_display_h();
+
+    std::uint64_t offset = align8(sizeof(snapshot_header));
+    header.sites = {offset, sites.size()};
+    offset = align8(offset + sites.size() * sizeof(snapshot_point));
+    header.vertices = {offset, vertices.size()};
+    offset = align8(offset + vertices.size() * sizeof(snapshot_point));
+    header.edges = {offset, edges.size()};
+    offset = align8(offset + edges.size() * sizeof(snapshot_edge));
+    header.cell_offsets = {offset, cell_offsets.size()};
+    offset = align8(offset + cell_offsets.size() * sizeof(std::uint32_t));
+    header.cell_edges = {offset, cell_edges.size()};
+    header.file_size = offset + cell_edges.size() * sizeof(std::uint32_t);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "Could not open " << path << " for writing" << std::endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write_section(out, sites, header.sites);
+    write_section(out, vertices, header.vertices);
+    write_section(out, edges, header.edges);
+    write_section(out, cell_offsets, header.cell_offsets);
+    write_section(out, cell_edges, header.cell_edges);
+    out.close();
+    if (!out)
+    {
+        std::cerr << "Failed writing snapshot to " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool snapshot_view::open(const std::string& path)
+{
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        std::cerr << "Could not open snapshot " << path << std::endl;
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+    {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    if (mapping == nullptr)
+    {
+        std::cerr << "Could not map snapshot " << path << std::endl;
+        CloseHandle(file);
+        return false;
+    }
+    data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    size = static_cast<std::size_t>(file_size.QuadPart);
+    file_handle = file;
+    mapping_handle = mapping;
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Could not open snapshot " << path << std::endl;
+        return false;
+    }
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+        std::cerr << "Could not stat snapshot " << path << std::endl;
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); //the mapping keeps the file alive
+    if (mapped != MAP_FAILED)
+    {
+        data = static_cast<const unsigned char*>(mapped);
+        size = static_cast<std::size_t>(info.st_size);
+    }
+#endif
+    if (data == nullptr)
+    {
+        std::cerr << "Could not map snapshot " << path << std::endl;
+        close();
+        return false;
+    }
+    if (!validate())
+    {
+        std::cerr << "Snapshot " << path << " is not a valid voronoi snapshot" << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void snapshot_view::close()
+{
+#ifdef _WIN32
+    if (data != nullptr) UnmapViewOfFile(data);
+    if (mapping_handle != nullptr) CloseHandle(mapping_handle);
+    if (file_handle != nullptr) CloseHandle(file_handle);
+    mapping_handle = nullptr;
+    file_handle = nullptr;
+#else
+    if (data != nullptr) munmap(const_cast<unsigned char*>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+bool snapshot_view::validate() const
+{
+    if (size < sizeof(snapshot_header)) return false;
+    const snapshot_header& h = header();
+    if (std::memcmp(h.magic, snapshot_magic, sizeof(h.magic)) != 0) return false;
+    if (h.version != snapshot_version || h.endian_tag != snapshot_endian_tag) return false;
+    if (h.header_size != sizeof(snapshot_header) || h.file_size > size) return false;
+
+    //every section has to be aligned and inside the file
+    const auto fits = [&](const snapshot_section& s, const std::uint64_t element_size) {
+        return s.offset % 8 == 0 && s.offset <= h.file_size && s.count <= (h.file_size - s.offset) / element_size;
+    };
+    if (!fits(h.sites, sizeof(snapshot_point)) || !fits(h.vertices, sizeof(snapshot_point)) ||
+        !fits(h.edges, sizeof(snapshot_edge)) || !fits(h.cell_offsets, sizeof(std::uint32_t)) ||
+        !fits(h.cell_edges, sizeof(std::uint32_t)))
+    {
+        return false;
+    }
+    if (h.cell_offsets.count != h.sites.count + 1) return false;
+
+    //the readers index straight into the mapping, so every index in the file has to point inside its section
+    const std::uint32_t* offsets = cell_offsets();
+    if (offsets[0] != 0 || offsets[h.sites.count] != h.cell_edges.count) return false;
+    for (std::uint64_t i = 0; i < h.sites.count; i++)
+    {
+        if (offsets[i] > offsets[i+1]) return false;
+    }
+    const std::uint32_t* edge_indices = cell_edges();
+    for (std::uint64_t i = 0; i < h.cell_edges.count; i++)
+    {
+        if (edge_indices[i] >= h.edges.count) return false;
+    }
+    const snapshot_edge* edge_list = edges();
+    const auto valid_site = [&](const std::uint32_t site) {return site == snapshot_no_site || site < h.sites.count;};
+    for (std::uint64_t i = 0; i < h.edges.count; i++)
+    {
+        if (!valid_site(edge_list[i].site_a) || !valid_site(edge_list[i].site_b)) return false;
+    }
+    return true;
+}
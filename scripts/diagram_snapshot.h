@@ -0,0 +1,103 @@
+#pragma once
+//flat, offset based snapshot of a finished voronoi_diagram.
+//the file is laid out so that other processes can mmap it and read the arrays directly, no parsing step.
+//
+//layout (all offsets from the start of the file, every section 8-byte aligned, native little endian):
+//  snapshot_header
+//  sites         snapshot_point[sites.count]
+//  vertices      snapshot_point[vertices.count]
+//  edges         snapshot_edge[edges.count]
+//  cell_offsets  uint32[sites.count+1]  - edges of cell i are cell_edges[cell_offsets[i] .. cell_offsets[i+1]]
+//  cell_edges    uint32[...]            - indices into edges
+//
+//writing to a path under /dev/shm gives a shared memory segment on linux.
+
+#include "voronoi.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+static constexpr char snapshot_magic[8] = {'V','O','R','S','N','A','P','\0'};
+static constexpr std::uint32_t snapshot_version = 1;
+static constexpr std::uint32_t snapshot_endian_tag = 0x01020304;
+static constexpr std::uint32_t snapshot_no_site = 0xFFFFFFFF;
+
+struct snapshot_section {
+    std::uint64_t offset;
+    std::uint64_t count;
+};
+
+struct snapshot_point {
+    double x;
+    double y;
+};
+
+struct snapshot_edge {
+    snapshot_point start;
+    snapshot_point end;
+    std::uint32_t site_a; //index into sites, snapshot_no_site if unknown
+    std::uint32_t site_b;
+};
+
+struct snapshot_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t endian_tag;
+    std::uint64_t header_size;
+    std::uint64_t file_size;
+    double width;
+    double height;
+    snapshot_section sites;
+    snapshot_section vertices;
+    snapshot_section edges;
+    snapshot_section cell_offsets;
+    snapshot_section cell_edges;
+};
+
+//the diagram should be finished (run_voronoi) before it is written
+bool write_snapshot(const voronoi_diagram& diagram, const std::string& path);
+
+//read only view of a snapshot file, the arrays point straight into the mapping
+class snapshot_view {
+    public:
+        snapshot_view() = default;
+        explicit snapshot_view(const std::string& path) {open(path);}
+        ~snapshot_view() {close();}
+        snapshot_view(const snapshot_view&) = delete;
+        snapshot_view& operator=(const snapshot_view&) = delete;
+
+        bool open(const std::string& path);
+        void close();
+        bool is_open() const {return data != nullptr;}
+
+        const snapshot_header& header() const {return *reinterpret_cast<const snapshot_header*>(data);}
+        double width() const {return header().width;}
+        double height() const {return header().height;}
+
+        std::size_t site_count() const {return static_cast<std::size_t>(header().sites.count);}
+        std::size_t vertex_count() const {return static_cast<std::size_t>(header().vertices.count);}
+        std::size_t edge_count() const {return static_cast<std::size_t>(header().edges.count);}
+
+        const snapshot_point* sites() const {return section<snapshot_point>(header().sites);}
+        const snapshot_point* vertices() const {return section<snapshot_point>(header().vertices);}
+        const snapshot_edge* edges() const {return section<snapshot_edge>(header().edges);}
+
+        //edge indices bordering the cell of site i
+        const std::uint32_t* cell_begin(std::size_t i) const {return cell_edges() + cell_offsets()[i];}
+        const std::uint32_t* cell_end(std::size_t i) const {return cell_edges() + cell_offsets()[i+1];}
+
+    private:
+        template<typename T>
+        const T* section(const snapshot_section& s) const {return reinterpret_cast<const T*>(data + s.offset);}
+        const std::uint32_t* cell_offsets() const {return section<std::uint32_t>(header().cell_offsets);}
+        const std::uint32_t* cell_edges() const {return section<std::uint32_t>(header().cell_edges);}
+        bool validate() const;
+
+        const unsigned char* data = nullptr;
+        std::size_t size = 0;
+#ifdef _WIN32
+        void* file_handle = nullptr;
+        void* mapping_handle = nullptr;
+#endif
+};
@@ -0,0 +1,161 @@
+#include "distance_transform.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    constexpr std::int32_t no_site = std::numeric_limits<std::int32_t>::max() / 4; //"infinite" row distance, +1 can not overflow
+    constexpr int column_band = 256; //columns per task in the vertical pass
+
+    //one step of the vertical pass over columns [x0, x1): a pixel takes the neighbouring row's site if that is closer.
+    //every column is independent, so this runs 8 (AVX2) or 4 (SSE2) columns per instruction.
+    void relax_row(std::int32_t* distance, std::int32_t* label, const std::int32_t* neighbour_distance, const std::int32_t* neighbour_label, int x, const int x1)
+    {
+#if defined(__AVX2__)
+        const __m256i one = _mm256_set1_epi32(1);
+        for (; x + 8 <= x1; x += 8)
+        {
+            const __m256i candidate = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(neighbour_distance + x)), one);
+            const __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(distance + x));
+            const __m256i closer = _mm256_cmpgt_epi32(current, candidate);
+            const __m256i current_label = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(label + x));
+            const __m256i candidate_label = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(neighbour_label + x));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(distance + x), _mm256_min_epi32(current, candidate));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(label + x), _mm256_blendv_epi8(current_label, candidate_label, closer));
+        }
+#elif defined(__SSE2__)
+        const __m128i one = _mm_set1_epi32(1);
+        for (; x + 4 <= x1; x += 4)
+        {
+            const __m128i candidate = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(neighbour_distance + x)), one);
+            const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(distance + x));
+            const __m128i closer = _mm_cmpgt_epi32(current, candidate);
+            const __m128i current_label = _mm_loadu_si128(reinterpret_cast<const __m128i*>(label + x));
+            const __m128i candidate_label = _mm_loadu_si128(reinterpret_cast<const __m128i*>(neighbour_label + x));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(distance + x), _mm_or_si128(_mm_and_si128(closer, candidate), _mm_andnot_si128(closer, current)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(label + x), _mm_or_si128(_mm_and_si128(closer, candidate_label), _mm_andnot_si128(closer, current_label)));
+        }
+#endif
+        for (; x < x1; x++)
+        {
+            const std::int32_t candidate = neighbour_distance[x] + 1;
+            if (candidate < distance[x])
+            {
+                distance[x] = candidate;
+                label[x] = neighbour_label[x];
+            }
+        }
+    }
+}
+
+label_map compute_label_map(const std::vector<point>& sites, const int width, const int height, const double scale_x, const double scale_y)
+{
+    label_map map;
+    if (width <= 0 || height <= 0)
+    {
+        return map;
+    }
+    map.width = width;
+    map.height = height;
+    const std::size_t pixel_count = static_cast<std::size_t>(width) * height;
+    map.labels.assign(pixel_count, -1);
+    map.distances.assign(pixel_count, std::numeric_limits<float>::infinity());
+
+    //vertical distance (in rows) to the nearest site in the same column, the labels array doubles as its label
+    std::vector<std::int32_t> column_distance(pixel_count, no_site);
+    for (std::size_t i = 0; i < sites.size(); i++)
+    {
+        const double x = std::floor(sites[i].x * scale_x);
+        const double y = std::floor(sites[i].y * scale_y);
+        if (x < 0 || y < 0 || x >= width || y >= height)
+        {
+            continue;
+        }
+        const std::size_t pixel = static_cast<std::size_t>(y) * width + static_cast<std::size_t>(x);
+        if (map.labels[pixel] < 0) //first site in a pixel wins
+        {
+            map.labels[pixel] = static_cast<std::int32_t>(i);
+            column_distance[pixel] = 0;
+        }
+    }
+
+    //pass 1: down and then up every column, bands of columns in parallel
+    const int bands = (width + column_band - 1) / column_band;
+    parallel_for(0, static_cast<std::size_t>(bands), [&](const std::size_t band) {
+        const int x0 = static_cast<int>(band) * column_band;
+        const int x1 = std::min(x0 + column_band, width);
+        for (int y = 1; y < height; y++)
+        {
+            const std::size_t row = static_cast<std::size_t>(y) * width;
+            relax_row(&column_distance[row], &map.labels[row], &column_distance[row - width], &map.labels[row - width], x0, x1);
+        }
+        for (int y = height - 2; y >= 0; y--)
+        {
+            const std::size_t row = static_cast<std::size_t>(y) * width;
+            relax_row(&column_distance[row], &map.labels[row], &column_distance[row + width], &map.labels[row + width], x0, x1);
+        }
+    });
+
+    //pass 2: lower envelope of the parabolas (x-q)^2 + column_distance(q)^2 along every row, rows in parallel
+    parallel_for(0, static_cast<std::size_t>(height), [&](const std::size_t y) {
+        thread_local std::vector<int> vertices;    //columns whose parabola is part of the envelope
+        thread_local std::vector<double> bounds;   //where each envelope parabola starts
+        thread_local std::vector<std::int32_t> row_labels;
+        vertices.resize(static_cast<std::size_t>(width));
+        bounds.resize(static_cast<std::size_t>(width) + 1);
+
+        const std::size_t row = y * width;
+        const std::int32_t* g = &column_distance[row];
+        row_labels.assign(map.labels.begin() + static_cast<std::ptrdiff_t>(row), map.labels.begin() + static_cast<std::ptrdiff_t>(row + width));
+        const auto f = [&](const int q) {return static_cast<double>(g[q]) * g[q];};
+
+        int k = -1;
+        for (int q = 0; q < width; q++)
+        {
+            if (g[q] >= no_site)
+            {
+                continue;
+            }
+            double s = -std::numeric_limits<double>::infinity();
+            while (k >= 0)
+            {
+                const int v = vertices[k];
+                s = ((f(q) + static_cast<double>(q) * q) - (f(v) + static_cast<double>(v) * v)) / (2.0 * (q - v));
+                if (s > bounds[k])
+                {
+                    break;
+                }
+                k--;
+            }
+            k++;
+            vertices[k] = q;
+            bounds[k] = k == 0 ? -std::numeric_limits<double>::infinity() : s;
+            bounds[k + 1] = std::numeric_limits<double>::infinity();
+        }
+        if (k < 0)
+        {
+            return; //no site anywhere in the image
+        }
+
+        int j = 0;
+        for (int x = 0; x < width; x++)
+        {
+            while (bounds[j + 1] < x)
+            {
+                j++;
+            }
+            const int v = vertices[j];
+            map.distances[row + x] = static_cast<float>(static_cast<double>(x - v) * (x - v) + f(v));
+            map.labels[row + x] = row_labels[v];
+        }
+    });
+    return map;
+}
@@ -0,0 +1,22 @@
+#pragma once
+//raster voronoi diagram: for every pixel the index of the nearest site and the squared distance to it.
+//uses the exact separable euclidean distance transform (Felzenszwalb & Huttenlocher), so the cost is linear in the
+//number of pixels no matter how many sites there are. sites are snapped to the pixel they fall in.
+
+#include "utilities.h"
+
+#include <cstdint>
+#include <vector>
+
+struct label_map {
+    int width = 0;
+    int height = 0;
+    std::vector<std::int32_t> labels; //index into the sites, -1 when there are no sites in the image
+    std::vector<float> distances; //squared distance in pixels to the nearest site
+
+    std::int32_t label(const int x, const int y) const {return labels[static_cast<std::size_t>(y) * width + x];}
+    float distance(const int x, const int y) const {return distances[static_cast<std::size_t>(y) * width + x];}
+};
+
+//site (x, y) lands in pixel (x*scale_x, y*scale_y), sites outside the image are ignored
+label_map compute_label_map(const std::vector<point>& sites, int width, int height, double scale_x = 1.0, double scale_y = 1.0);
@@ -0,0 +1,290 @@
+#include "geometry_batch.h"
+
+#include <limits>
+#include <stdexcept>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    //the few lane operations the kernels need, one set per instruction set
+#if defined(__AVX512F__)
+    using lanes = __m512d;
+    using lane_mask = __mmask8;
+    constexpr std::size_t width = 8;
+    inline lanes splat(const double value) {return _mm512_set1_pd(value);}
+    inline lanes load(const double* values) {return _mm512_loadu_pd(values);}
+    inline void store(double* values, const lanes v) {_mm512_storeu_pd(values, v);}
+    inline lanes add(const lanes a, const lanes b) {return _mm512_add_pd(a, b);}
+    inline lanes sub(const lanes a, const lanes b) {return _mm512_sub_pd(a, b);}
+    inline lanes mul(const lanes a, const lanes b) {return _mm512_mul_pd(a, b);}
+    inline lanes divide(const lanes a, const lanes b) {return _mm512_div_pd(a, b);}
+    inline lanes root(const lanes a) {return _mm512_sqrt_pd(a);}
+    inline lanes absolute(const lanes a) {return _mm512_abs_pd(a);}
+    inline lanes minimum(const lanes a, const lanes b) {return _mm512_min_pd(a, b);}
+    inline lanes maximum(const lanes a, const lanes b) {return _mm512_max_pd(a, b);}
+    inline lane_mask less(const lanes a, const lanes b) {return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ);}
+    inline lane_mask greater(const lanes a, const lanes b) {return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ);}
+    inline lane_mask equal(const lanes a, const lanes b) {return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ);}
+    inline lane_mask both(const lane_mask a, const lane_mask b) {return static_cast<lane_mask>(a & b);}
+    inline lane_mask either(const lane_mask a, const lane_mask b) {return static_cast<lane_mask>(a | b);}
+    inline lanes select(const lane_mask mask, const lanes if_set, const lanes otherwise) {return _mm512_mask_blend_pd(mask, otherwise, if_set);}
+#elif defined(__AVX2__)
+    using lanes = __m256d;
+    using lane_mask = __m256d;
+    constexpr std::size_t width = 4;
+    inline lanes splat(const double value) {return _mm256_set1_pd(value);}
+    inline lanes load(const double* values) {return _mm256_loadu_pd(values);}
+    inline void store(double* values, const lanes v) {_mm256_storeu_pd(values, v);}
+    inline lanes add(const lanes a, const lanes b) {return _mm256_add_pd(a, b);}
+    inline lanes sub(const lanes a, const lanes b) {return _mm256_sub_pd(a, b);}
+    inline lanes mul(const lanes a, const lanes b) {return _mm256_mul_pd(a, b);}
+    inline lanes divide(const lanes a, const lanes b) {return _mm256_div_pd(a, b);}
+    inline lanes root(const lanes a) {return _mm256_sqrt_pd(a);}
+    inline lanes absolute(const lanes a) {return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a);}
+    inline lanes minimum(const lanes a, const lanes b) {return _mm256_min_pd(a, b);}
+    inline lanes maximum(const lanes a, const lanes b) {return _mm256_max_pd(a, b);}
+    inline lane_mask less(const lanes a, const lanes b) {return _mm256_cmp_pd(a, b, _CMP_LT_OQ);}
+    inline lane_mask greater(const lanes a, const lanes b) {return _mm256_cmp_pd(a, b, _CMP_GT_OQ);}
+    inline lane_mask equal(const lanes a, const lanes b) {return _mm256_cmp_pd(a, b, _CMP_EQ_OQ);}
+    inline lane_mask both(const lane_mask a, const lane_mask b) {return _mm256_and_pd(a, b);}
+    inline lane_mask either(const lane_mask a, const lane_mask b) {return _mm256_or_pd(a, b);}
+    inline lanes select(const lane_mask mask, const lanes if_set, const lanes otherwise) {return _mm256_blendv_pd(otherwise, if_set, mask);}
+#elif defined(__SSE2__)
+    using lanes = __m128d;
+    using lane_mask = __m128d;
+    constexpr std::size_t width = 2;
+    inline lanes splat(const double value) {return _mm_set1_pd(value);}
+    inline lanes load(const double* values) {return _mm_loadu_pd(values);}
+    inline void store(double* values, const lanes v) {_mm_storeu_pd(values, v);}
+    inline lanes add(const lanes a, const lanes b) {return _mm_add_pd(a, b);}
+    inline lanes sub(const lanes a, const lanes b) {return _mm_sub_pd(a, b);}
+    inline lanes mul(const lanes a, const lanes b) {return _mm_mul_pd(a, b);}
+    inline lanes divide(const lanes a, const lanes b) {return _mm_div_pd(a, b);}
+    inline lanes root(const lanes a) {return _mm_sqrt_pd(a);}
+    inline lanes absolute(const lanes a) {return _mm_andnot_pd(_mm_set1_pd(-0.0), a);}
+    inline lanes minimum(const lanes a, const lanes b) {return _mm_min_pd(a, b);}
+    inline lanes maximum(const lanes a, const lanes b) {return _mm_max_pd(a, b);}
+    inline lane_mask less(const lanes a, const lanes b) {return _mm_cmplt_pd(a, b);}
+    inline lane_mask greater(const lanes a, const lanes b) {return _mm_cmpgt_pd(a, b);}
+    inline lane_mask equal(const lanes a, const lanes b) {return _mm_cmpeq_pd(a, b);}
+    inline lane_mask both(const lane_mask a, const lane_mask b) {return _mm_and_pd(a, b);}
+    inline lane_mask either(const lane_mask a, const lane_mask b) {return _mm_or_pd(a, b);}
+    inline lanes select(const lane_mask mask, const lanes if_set, const lanes otherwise) {return _mm_or_pd(_mm_and_pd(mask, if_set), _mm_andnot_pd(mask, otherwise));}
+#endif
+
+#if defined(__SSE2__)
+    static_assert(sizeof(point) == 2 * sizeof(double), "gather reads points as x, y after each other");
+    enum field : int {x_field, y_field};
+
+    //one field of width points in a row. going through memory instead would stall the wide load on the narrow stores
+    inline lanes gather(const point* points, const field f)
+    {
+        const double* first = &points->x + f;
+#if defined(__AVX512F__)
+        return _mm512_i64gather_pd(_mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0), first, 8);
+#elif defined(__AVX2__)
+        return _mm256_i64gather_pd(first, _mm256_set_epi64x(6, 4, 2, 0), 8);
+#else
+        return _mm_set_pd(first[2], first[0]);
+#endif
+    }
+
+    //width weights from i on, zeros without weights
+    inline lanes weights_at(const double* weights, const std::size_t i)
+    {
+        return weights == nullptr ? splat(0.0) : load(weights + i);
+    }
+
+    //the y of calculate_y_parabola, written out the same way
+    inline lanes parabola_y(const lanes x, const lanes site_x, const lanes site_y, const lanes weight, const lanes sweep, const lanes two)
+    {
+        const lanes numerator = sub(sub(add(add(sub(mul(x, x), mul(mul(two, x), site_x)), mul(site_x, site_x)), mul(site_y, site_y)), weight), mul(sweep, sweep));
+        return divide(numerator, sub(mul(two, site_y), mul(two, sweep)));
+    }
+#endif
+}
+
+const char* geometry_instruction_set()
+{
+#if defined(__AVX512F__)
+    return "AVX-512";
+#elif defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSE2__)
+    return "SSE2";
+#else
+    return "none";
+#endif
+}
+
+void parabola_intersections(const point* arcs, const double* weights, const std::size_t count, const double y_sweepline, double* xs)
+{
+    if (count < 2)
+    {
+        return;
+    }
+    const std::size_t pairs = count - 1;
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const lanes sweep = splat(y_sweepline);
+    const lanes zero = splat(0.0);
+    const lanes two = splat(2.0);
+    const lanes four = splat(4.0);
+    const lanes minus_one = splat(-1.0);
+    const lanes nudge = splat(1e-5);
+    for (; i + width <= pairs; i += width)
+    {
+        const lanes ax = gather(arcs + i, x_field);
+        const lanes ay = gather(arcs + i, y_field);
+        const lanes aw = weights_at(weights, i);
+        const lanes bx = gather(arcs + i + 1, x_field);
+        const lanes by = gather(arcs + i + 1, y_field);
+        const lanes bw = weights_at(weights, i + 1);
+
+        const lanes a = mul(two, sub(by, ay));
+        const lanes b = mul(four, sub(add(sub(mul(ay, bx), mul(by, ax)), mul(sweep, ax)), mul(sweep, bx)));
+        const lanes sweep_squared = mul(sweep, sweep);
+        const lanes c = sub(mul(sub(sub(add(mul(ax, ax), mul(ay, ay)), aw), sweep_squared), sub(mul(two, by), mul(two, sweep))),
+                            mul(sub(sub(add(mul(bx, bx), mul(by, by)), bw), sweep_squared), sub(mul(two, ay), mul(two, sweep))));
+        const lanes sqrt_discriminant = root(absolute(sub(mul(b, b), mul(mul(four, a), c))));
+        const lanes minus_b = mul(minus_one, b);
+        const lanes x1 = add(divide(add(minus_b, sqrt_discriminant), mul(two, a)), nudge);
+        const lanes x2 = sub(divide(sub(minus_b, sqrt_discriminant), mul(two, a)), nudge);
+        const lane_mask a_higher = greater(ay, by);
+        const lane_mask take_max = either(both(less(ax, bx), a_higher), both(greater(ax, bx), a_higher));
+        const lanes x = select(take_max, maximum(x1, x2), minimum(x1, x2));
+
+        //sites at the same height: the middle, shifted by the weights. these lanes divided by zero above
+        const lanes low = minimum(ax, bx);
+        const lanes high = maximum(ax, bx);
+        const lanes shift = select(equal(ax, bx), zero, divide(sub(aw, bw), mul(two, sub(bx, ax))));
+        const lanes middle = add(add(low, divide(sub(high, low), two)), shift);
+        store(xs + i, select(equal(a, zero), middle, x));
+    }
+#endif
+    for (; i < pairs; i++)
+    {
+        xs[i] = weights == nullptr ? calculate_parabola_intersection(arcs[i], arcs[i + 1], y_sweepline)
+                                   : calculate_parabola_intersection(arcs[i], arcs[i + 1], y_sweepline, weights[i], weights[i + 1]);
+    }
+}
+
+void arc_ys(const point* sites, const double* weights, const double* xs, const std::size_t count, const double y_sweepline, double* ys)
+{
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const lanes sweep = splat(y_sweepline);
+    const lanes two = splat(2.0);
+    for (; i + width <= count; i += width)
+    {
+        store(ys + i, parabola_y(load(xs + i), gather(sites + i, x_field), gather(sites + i, y_field), weights_at(weights, i), sweep, two));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        ys[i] = calculate_y_parabola(xs[i], sites[i].x, sites[i].y, y_sweepline, weights == nullptr ? 0.0 : weights[i]);
+    }
+}
+
+void parabola_ys(const double* xs, const std::size_t count, const point& site, const double y_sweepline, double* ys, const double weight)
+{
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const lanes sweep = splat(y_sweepline);
+    const lanes two = splat(2.0);
+    const lanes site_x = splat(site.x);
+    const lanes site_y = splat(site.y);
+    const lanes site_weight = splat(weight);
+    for (; i + width <= count; i += width)
+    {
+        store(ys + i, parabola_y(load(xs + i), site_x, site_y, site_weight, sweep, two));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        ys[i] = calculate_y_parabola(xs[i], site.x, site.y, y_sweepline, weight);
+    }
+}
+
+void circumcircles(const point* a, const point* b, const point* c, const std::size_t count, double* center_x, double* center_y, double* radius)
+{
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const lanes zero = splat(0.0);
+    const lanes two = splat(2.0);
+    const lanes not_a_number = splat(std::numeric_limits<double>::quiet_NaN());
+    for (; i + width <= count; i += width)
+    {
+        const lanes ax = gather(a + i, x_field);
+        const lanes ay = gather(a + i, y_field);
+        const lanes bx = gather(b + i, x_field);
+        const lanes by = gather(b + i, y_field);
+        const lanes cx = gather(c + i, x_field);
+        const lanes cy = gather(c + i, y_field);
+
+        const lanes determinant = add(add(mul(ax, sub(by, cy)), mul(bx, sub(cy, ay))), mul(cx, sub(ay, by)));
+        const lanes a_lift = add(mul(ax, ax), mul(ay, ay));
+        const lanes b_lift = add(mul(bx, bx), mul(by, by));
+        const lanes c_lift = add(mul(cx, cx), mul(cy, cy));
+        const lanes x = divide(add(add(mul(a_lift, sub(by, cy)), mul(b_lift, sub(cy, ay))), mul(c_lift, sub(ay, by))), mul(two, determinant));
+        const lanes y = divide(add(add(mul(a_lift, sub(cx, bx)), mul(b_lift, sub(ax, cx))), mul(c_lift, sub(bx, ax))), mul(two, determinant));
+        const lanes power = add(mul(sub(ax, x), sub(ax, x)), mul(sub(ay, y), sub(ay, y)));
+        const lane_mask collinear = equal(determinant, zero);
+        store(center_x + i, select(collinear, not_a_number, x));
+        store(center_y + i, select(collinear, not_a_number, y));
+        store(radius + i, select(collinear, not_a_number, root(maximum(power, zero)))); //max(power, 0) is 0 for NaN, like std::max(0.0, power)
+    }
+#endif
+    for (; i < count; i++)
+    {
+        try
+        {
+            const circle result = circumcircle(a[i], b[i], c[i]);
+            center_x[i] = result.center.x;
+            center_y[i] = result.center.y;
+            radius[i] = result.radius;
+        }
+        catch (const std::invalid_argument&)
+        {
+            center_x[i] = center_y[i] = radius[i] = std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+}
+
+void mirror_points(const point* points, const std::size_t count, const point line_a, const point line_b, point* mirrored)
+{
+    const double ab_x = line_b.x - line_a.x;
+    const double ab_y = line_b.y - line_a.y;
+    const double ab_ab = ab_x * ab_x + ab_y * ab_y;
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const lanes two = splat(2.0);
+    const lanes a_x = splat(line_a.x);
+    const lanes a_y = splat(line_a.y);
+    const lanes direction_x = splat(ab_x);
+    const lanes direction_y = splat(ab_y);
+    const lanes length_squared = splat(ab_ab);
+    alignas(64) double xs[width];
+    alignas(64) double ys[width];
+    for (; i + width <= count; i += width)
+    {
+        const lanes px = gather(points + i, x_field);
+        const lanes py = gather(points + i, y_field);
+        const lanes along = divide(add(mul(sub(px, a_x), direction_x), mul(sub(py, a_y), direction_y)), length_squared);
+        store(xs, sub(mul(two, add(a_x, mul(along, direction_x))), px));
+        store(ys, sub(mul(two, add(a_y, mul(along, direction_y))), py));
+        for (std::size_t k = 0; k < width; k++)
+        {
+            mirrored[i + k] = point(xs[k], ys[k]);
+        }
+    }
+#endif
+    for (; i < count; i++)
+    {
+        mirrored[i] = mirror_point(points[i], line_a, line_b);
+    }
+}
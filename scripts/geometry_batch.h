@@ -0,0 +1,27 @@
+#pragma once
+//the parabola and circle formulas of utilities.h over arrays, several inputs per instruction: 8 with AVX-512, 4 with
+//AVX2, 2 with SSE2 (build with VORONOI_NATIVE_ARCH for the wider ones), what is left over one at a time. every lane
+//does the same operations in the same order as the scalar function, so the results only differ where the compiler
+//fuses a multiply and an add in one of them and not the other.
+
+#include "utilities.h"
+
+#include <cstddef>
+
+const char* geometry_instruction_set(); //what the batch functions were built with: AVX-512, AVX2, SSE2 or none
+
+//xs[i] = calculate_parabola_intersection(arcs[i], arcs[i+1], y_sweepline, ...) for the count-1 neighbouring pairs.
+//weights[i] is the weight of arcs[i], null when they are all 0
+void parabola_intersections(const point* arcs, const double* weights, std::size_t count, double y_sweepline, double* xs);
+
+//ys[i] = calculate_y_parabola(xs[i], ...) on the arc of sites[i], weights like parabola_intersections
+void arc_ys(const point* sites, const double* weights, const double* xs, std::size_t count, double y_sweepline, double* ys);
+
+//ys[i] = calculate_y_parabola(xs[i], ...) on the arc of one site, e.g. along a row of pixels
+void parabola_ys(const double* xs, std::size_t count, const point& site, double y_sweepline, double* ys, double weight = 0.0);
+
+//circumcircle(a[i], b[i], c[i]). where the scalar one throws for collinear points this gives NaN
+void circumcircles(const point* a, const point* b, const point* c, std::size_t count, double* center_x, double* center_y, double* radius);
+
+//mirror_point(points[i], line_a, line_b)
+void mirror_points(const point* points, std::size_t count, point line_a, point line_b, point* mirrored);
@@ -0,0 +1,398 @@
+#include "image_io.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    //larger images are refused before anything is allocated for them, which also keeps every size below in range
+    constexpr std::uint32_t max_image_side = 1 << 16;
+    constexpr std::uint64_t max_image_pixels = 1 << 28;
+
+    bool image_size_ok(const std::uint64_t width, const std::uint64_t height)
+    {
+        return width > 0 && height > 0 && width <= max_image_side && height <= max_image_side && width * height <= max_image_pixels;
+    }
+
+    //minimal inflate (RFC 1951) for PNG image data, follows the structure of zlib's puff.c. output past limit bytes is
+    //refused as it comes, so a small stream can not inflate into more memory than the image needs
+    class inflater {
+        public:
+            inflater(const unsigned char* data, const std::size_t size, const std::size_t limit) : data(data), size(size), limit(limit) {}
+
+            std::vector<unsigned char> run()
+            {
+                std::vector<unsigned char> out;
+                bool last = false;
+                while (!last)
+                {
+                    last = bits(1) == 1;
+                    const int type = static_cast<int>(bits(2));
+                    if (type == 0) stored(out);
+                    else if (type == 1) fixed(out);
+                    else if (type == 2) dynamic(out);
+                    else throw std::runtime_error("invalid deflate block type");
+                }
+                return out;
+            }
+
+        private:
+            struct huffman {
+                std::array<short, 16> count{};
+                std::vector<short> symbol;
+            };
+
+            std::uint32_t bits(const int need)
+            {
+                while (bit_count < need)
+                {
+                    if (position >= size) throw std::runtime_error("deflate stream ends early");
+                    bit_buffer |= static_cast<std::uint32_t>(data[position++]) << bit_count;
+                    bit_count += 8;
+                }
+                const std::uint32_t value = bit_buffer & ((1u << need) - 1);
+                bit_buffer >>= need;
+                bit_count -= need;
+                return value;
+            }
+
+            static huffman build(const short* lengths, const int n)
+            {
+                huffman h;
+                h.symbol.resize(static_cast<std::size_t>(n));
+                for (int i = 0; i < n; i++) h.count[lengths[i]]++;
+                //more codes of a length than are left free for it, the code can not be decoded
+                int left = 1;
+                for (int len = 1; len <= 15; len++)
+                {
+                    left = (left << 1) - h.count[len];
+                    if (left < 0) throw std::runtime_error("over-subscribed huffman code");
+                }
+                std::array<short, 16> offsets{};
+                for (int len = 1; len < 15; len++) offsets[len + 1] = static_cast<short>(offsets[len] + h.count[len]);
+                for (int i = 0; i < n; i++)
+                {
+                    if (lengths[i] != 0) h.symbol[offsets[lengths[i]]++] = static_cast<short>(i);
+                }
+                return h;
+            }
+
+            int decode(const huffman& h)
+            {
+                int code = 0, first = 0, index = 0;
+                for (int len = 1; len <= 15; len++)
+                {
+                    code |= static_cast<int>(bits(1));
+                    const int count = h.count[len];
+                    if (code - count < first)
+                    {
+                        return h.symbol[index + (code - first)];
+                    }
+                    index += count;
+                    first = (first + count) << 1;
+                    code <<= 1;
+                }
+                throw std::runtime_error("invalid huffman code");
+            }
+
+            void stored(std::vector<unsigned char>& out)
+            {
+                bit_buffer = 0;
+                bit_count = 0;
+                if (position + 4 > size) throw std::runtime_error("stored block ends early");
+                const std::size_t length = data[position] | (data[position + 1] << 8);
+                const std::size_t complement = data[position + 2] | (data[position + 3] << 8);
+                position += 4;
+                if (length != (~complement & 0xFFFF) || position + length > size) throw std::runtime_error("bad stored block");
+                if (length > limit - out.size()) throw std::runtime_error("deflate stream longer than the image");
+                out.insert(out.end(), data + position, data + position + length);
+                position += length;
+            }
+
+            void codes(std::vector<unsigned char>& out, const huffman& lengths, const huffman& distances)
+            {
+                static const short length_base[29] = {3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258};
+                static const short length_extra[29] = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0};
+                static const short distance_base[30] = {1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577};
+                static const short distance_extra[30] = {0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+                for (;;)
+                {
+                    int symbol = decode(lengths);
+                    if (symbol < 256)
+                    {
+                        if (out.size() == limit) throw std::runtime_error("deflate stream longer than the image");
+                        out.push_back(static_cast<unsigned char>(symbol));
+                        continue;
+                    }
+                    if (symbol == 256)
+                    {
+                        return;
+                    }
+                    symbol -= 257;
+                    if (symbol >= 29) throw std::runtime_error("invalid length symbol");
+                    const std::size_t length = length_base[symbol] + bits(length_extra[symbol]);
+                    const int distance_symbol = decode(distances);
+                    if (distance_symbol >= 30) throw std::runtime_error("invalid distance symbol");
+                    const std::size_t distance = distance_base[distance_symbol] + bits(distance_extra[distance_symbol]);
+                    if (distance > out.size()) throw std::runtime_error("distance too far back");
+                    if (length > limit - out.size()) throw std::runtime_error("deflate stream longer than the image");
+                    const std::size_t from = out.size() - distance;
+                    for (std::size_t i = 0; i < length; i++)
+                    {
+                        out.push_back(out[from + i]);
+                    }
+                }
+            }
+
+            void fixed(std::vector<unsigned char>& out)
+            {
+                static const std::pair<huffman, huffman> tables = []() {
+                    short lengths[288];
+                    std::fill(lengths, lengths + 144, 8);
+                    std::fill(lengths + 144, lengths + 256, 9);
+                    std::fill(lengths + 256, lengths + 280, 7);
+                    std::fill(lengths + 280, lengths + 288, 8);
+                    short distances[30];
+                    std::fill(distances, distances + 30, 5);
+                    return std::make_pair(build(lengths, 288), build(distances, 30));
+                }();
+                codes(out, tables.first, tables.second);
+            }
+
+            void dynamic(std::vector<unsigned char>& out)
+            {
+                static const short order[19] = {16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15};
+                const int literal_count = static_cast<int>(bits(5)) + 257;
+                const int distance_count = static_cast<int>(bits(5)) + 1;
+                const int code_count = static_cast<int>(bits(4)) + 4;
+                if (literal_count > 286 || distance_count > 30) throw std::runtime_error("bad dynamic block counts");
+
+                short lengths[320] = {};
+                for (int i = 0; i < code_count; i++) lengths[order[i]] = static_cast<short>(bits(3));
+                const huffman length_codes = build(lengths, 19);
+
+                int index = 0;
+                while (index < literal_count + distance_count)
+                {
+                    const int symbol = decode(length_codes);
+                    if (symbol < 16)
+                    {
+                        lengths[index++] = static_cast<short>(symbol);
+                        continue;
+                    }
+                    short repeated = 0;
+                    int times;
+                    if (symbol == 16)
+                    {
+                        if (index == 0) throw std::runtime_error("repeat with no previous length");
+                        repeated = lengths[index - 1];
+                        times = 3 + static_cast<int>(bits(2));
+                    }
+                    else if (symbol == 17) times = 3 + static_cast<int>(bits(3));
+                    else times = 11 + static_cast<int>(bits(7));
+                    if (index + times > literal_count + distance_count) throw std::runtime_error("too many code lengths");
+                    while (times-- > 0) lengths[index++] = repeated;
+                }
+                codes(out, build(lengths, literal_count), build(lengths + literal_count, distance_count));
+            }
+
+            const unsigned char* data;
+            std::size_t size;
+            std::size_t limit;
+            std::size_t position = 0;
+            std::uint32_t bit_buffer = 0;
+            int bit_count = 0;
+    };
+
+    std::uint32_t read_u32(const unsigned char* p)
+    {
+        return (static_cast<std::uint32_t>(p[0]) << 24) | (static_cast<std::uint32_t>(p[1]) << 16) | (static_cast<std::uint32_t>(p[2]) << 8) | p[3];
+    }
+
+    bool load_png(const std::vector<unsigned char>& file, raster_image& image)
+    {
+        static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+        if (file.size() < 8 || !std::equal(signature, signature + 8, file.begin()))
+        {
+            throw std::runtime_error("not a png file");
+        }
+        std::uint32_t width = 0, height = 0;
+        int color_type = -1;
+        std::vector<unsigned char> compressed;
+        std::vector<rgba> palette;
+        for (std::size_t at = 8; at + 12 <= file.size(); )
+        {
+            const std::uint32_t length = read_u32(&file[at]);
+            if (length > file.size() - at - 12) throw std::runtime_error("truncated png chunk");
+            const std::string type(file.begin() + static_cast<std::ptrdiff_t>(at + 4), file.begin() + static_cast<std::ptrdiff_t>(at + 8));
+            const unsigned char* body = &file[at + 8];
+            if (type == "IHDR")
+            {
+                if (length < 13) throw std::runtime_error("png header chunk too short");
+                width = read_u32(body);
+                height = read_u32(body + 4);
+                color_type = body[9];
+                if (body[8] != 8 || body[12] != 0) throw std::runtime_error("only 8-bit non-interlaced png is supported");
+            }
+            else if (type == "PLTE")
+            {
+                for (std::uint32_t i = 0; i + 2 < length; i += 3) palette.push_back({body[i], body[i + 1], body[i + 2], 255});
+            }
+            else if (type == "tRNS" && color_type == 3)
+            {
+                for (std::uint32_t i = 0; i < length && i < palette.size(); i++) palette[i].a = body[i];
+            }
+            else if (type == "IDAT")
+            {
+                compressed.insert(compressed.end(), body, body + length);
+            }
+            else if (type == "IEND")
+            {
+                break;
+            }
+            at += 12 + length;
+        }
+
+        int channels;
+        switch (color_type)
+        {
+            case 0: channels = 1; break;
+            case 2: channels = 3; break;
+            case 3: channels = 1; break;
+            case 4: channels = 2; break;
+            case 6: channels = 4; break;
+            default: throw std::runtime_error("unsupported png colour type");
+        }
+        if (!image_size_ok(width, height) || compressed.size() < 2 || (compressed[0] & 0x0F) != 8)
+        {
+            throw std::runtime_error("bad png header or image data");
+        }
+        const std::size_t stride = static_cast<std::size_t>(width) * channels;
+        const std::vector<unsigned char> raw = inflater(compressed.data() + 2, compressed.size() - 2, (stride + 1) * height).run(); //skip the zlib header
+        if (raw.size() < (stride + 1) * height) throw std::runtime_error("png image data too short");
+
+        //undo the per row filters
+        std::vector<unsigned char> pixels(stride * height);
+        for (std::uint32_t y = 0; y < height; y++)
+        {
+            const unsigned char filter = raw[y * (stride + 1)];
+            const unsigned char* in = &raw[y * (stride + 1) + 1];
+            unsigned char* row = &pixels[y * stride];
+            const unsigned char* above = y > 0 ? &pixels[(y - 1) * stride] : nullptr;
+            for (std::size_t i = 0; i < stride; i++)
+            {
+                const int a = i >= static_cast<std::size_t>(channels) ? row[i - channels] : 0;
+                const int b = above ? above[i] : 0;
+                const int c = above && i >= static_cast<std::size_t>(channels) ? above[i - channels] : 0;
+                int predicted;
+                switch (filter)
+                {
+                    case 0: predicted = 0; break;
+                    case 1: predicted = a; break;
+                    case 2: predicted = b; break;
+                    case 3: predicted = (a + b) / 2; break;
+                    case 4:
+                    {
+                        const int p = a + b - c;
+                        const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                        predicted = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                        break;
+                    }
+                    default: throw std::runtime_error("bad png filter");
+                }
+                row[i] = static_cast<unsigned char>(in[i] + predicted);
+            }
+        }
+
+        image = raster_image(static_cast<int>(width), static_cast<int>(height));
+        for (std::size_t i = 0; i < static_cast<std::size_t>(width) * height; i++)
+        {
+            const unsigned char* p = &pixels[i * channels];
+            switch (color_type)
+            {
+                case 0: image.pixels[i] = {p[0], p[0], p[0], 255}; break;
+                case 2: image.pixels[i] = {p[0], p[1], p[2], 255}; break;
+                case 3: image.pixels[i] = p[0] < palette.size() ? palette[p[0]] : rgba{0, 0, 0, 255}; break;
+                case 4: image.pixels[i] = {p[0], p[0], p[0], p[1]}; break;
+                default: image.pixels[i] = {p[0], p[1], p[2], p[3]}; break;
+            }
+        }
+        return true;
+    }
+
+    bool load_ppm(const std::vector<unsigned char>& file, raster_image& image)
+    {
+        std::size_t at = 0;
+        //next whitespace separated number, skipping # comments
+        const auto number = [&]() {
+            while (at < file.size() && (std::isspace(file[at]) || file[at] == '#'))
+            {
+                if (file[at] == '#') while (at < file.size() && file[at] != '\n') at++;
+                else at++;
+            }
+            long value = 0;
+            bool any = false;
+            while (at < file.size() && std::isdigit(file[at]))
+            {
+                value = value * 10 + (file[at++] - '0');
+                any = true;
+                if (value > static_cast<long>(max_image_side)) throw std::runtime_error("ppm size too large");
+            }
+            if (!any) throw std::runtime_error("bad ppm header");
+            return value;
+        };
+        if (file.size() < 2 || file[0] != 'P' || file[1] != '6')
+        {
+            throw std::runtime_error("only binary (P6) ppm is supported");
+        }
+        at = 2;
+        const long width = number();
+        const long height = number();
+        const long max_value = number();
+        at++; //single whitespace before the pixels
+        if (width <= 0 || height <= 0 || !image_size_ok(static_cast<std::uint64_t>(width), static_cast<std::uint64_t>(height)) ||
+            max_value <= 0 || max_value > 255 || at > file.size() || static_cast<std::size_t>(width) * static_cast<std::size_t>(height) * 3 > file.size() - at)
+        {
+            throw std::runtime_error("bad ppm header or truncated pixels");
+        }
+        image = raster_image(static_cast<int>(width), static_cast<int>(height));
+        for (std::size_t i = 0; i < image.pixels.size(); i++, at += 3)
+        {
+            image.pixels[i] = {static_cast<std::uint8_t>(file[at] * 255 / max_value), static_cast<std::uint8_t>(file[at + 1] * 255 / max_value),
+                               static_cast<std::uint8_t>(file[at + 2] * 255 / max_value), 255};
+        }
+        return true;
+    }
+}
+
+bool load_image(const std::string& path, raster_image& image)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        std::cerr << "Could not open " << path << std::endl;
+        return false;
+    }
+    const std::vector<unsigned char> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const std::size_t dot = path.find_last_of('.');
+    std::string extension = dot == std::string::npos ? "" : path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](const unsigned char c) {return static_cast<char>(std::tolower(c));});
+    try
+    {
+        if (extension == "png") return load_png(file, image);
+        if (extension == "ppm") return load_ppm(file, image);
+        std::cerr << "Unknown image format for " << path << ", use .png or .ppm" << std::endl;
+    }
+    catch (const std::runtime_error& error)
+    {
+        std::cerr << "Could not read " << path << ": " << error.what() << std::endl;
+    }
+    return false;
+}
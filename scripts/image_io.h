@@ -0,0 +1,9 @@
+#pragma once
+//loading images into a raster_image, the writers live on raster_image itself
+
+#include "raster.h"
+
+#include <string>
+
+//binary PPM (P6) or 8-bit non-interlaced PNG (grey, rgb, palette, with or without alpha), picked by extension
+bool load_image(const std::string& path, raster_image& image);
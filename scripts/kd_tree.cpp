@@ -0,0 +1,305 @@
+#include "kd_tree.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+namespace {
+    constexpr int leaf_size = 16;          //ranges this small are scanned instead of split
+    constexpr int parallel_size = 1 << 16; //ranges this big build their two halves on two threads
+
+    //squared distances from (px, py) to the count points of a leaf
+    void squared_distances(const double* xs, const double* ys, const int count, const double px, const double py, double* out)
+    {
+        int i = 0;
+#if defined(__AVX2__)
+        const __m256d x = _mm256_set1_pd(px);
+        const __m256d y = _mm256_set1_pd(py);
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs + i), x);
+            const __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ys + i), y);
+            _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+        }
+#else
+        const __m128d x = _mm_set1_pd(px);
+        const __m128d y = _mm_set1_pd(py);
+        for (; i + 2 <= count; i += 2)
+        {
+            const __m128d dx = _mm_sub_pd(_mm_loadu_pd(xs + i), x);
+            const __m128d dy = _mm_sub_pd(_mm_loadu_pd(ys + i), y);
+            _mm_storeu_pd(out + i, _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)));
+        }
+#endif
+        for (; i < count; i++)
+        {
+            const double dx = xs[i] - px;
+            const double dy = ys[i] - py;
+            out[i] = dx * dx + dy * dy;
+        }
+    }
+
+    //bit i is set for every point i of a leaf inside the box
+    unsigned inside_box(const double* xs, const double* ys, const int count, const double min_x, const double min_y, const double max_x, const double max_y)
+    {
+        unsigned mask = 0;
+        int i = 0;
+#if defined(__AVX2__)
+        const __m256d low_x = _mm256_set1_pd(min_x);
+        const __m256d low_y = _mm256_set1_pd(min_y);
+        const __m256d high_x = _mm256_set1_pd(max_x);
+        const __m256d high_y = _mm256_set1_pd(max_y);
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m256d x = _mm256_loadu_pd(xs + i);
+            const __m256d y = _mm256_loadu_pd(ys + i);
+            const __m256d in_x = _mm256_and_pd(_mm256_cmp_pd(x, low_x, _CMP_GE_OQ), _mm256_cmp_pd(x, high_x, _CMP_LE_OQ));
+            const __m256d in_y = _mm256_and_pd(_mm256_cmp_pd(y, low_y, _CMP_GE_OQ), _mm256_cmp_pd(y, high_y, _CMP_LE_OQ));
+            mask |= static_cast<unsigned>(_mm256_movemask_pd(_mm256_and_pd(in_x, in_y))) << i;
+        }
+#else
+        const __m128d low_x = _mm_set1_pd(min_x);
+        const __m128d low_y = _mm_set1_pd(min_y);
+        const __m128d high_x = _mm_set1_pd(max_x);
+        const __m128d high_y = _mm_set1_pd(max_y);
+        for (; i + 2 <= count; i += 2)
+        {
+            const __m128d x = _mm_loadu_pd(xs + i);
+            const __m128d y = _mm_loadu_pd(ys + i);
+            const __m128d in_x = _mm_and_pd(_mm_cmpge_pd(x, low_x), _mm_cmple_pd(x, high_x));
+            const __m128d in_y = _mm_and_pd(_mm_cmpge_pd(y, low_y), _mm_cmple_pd(y, high_y));
+            mask |= static_cast<unsigned>(_mm_movemask_pd(_mm_and_pd(in_x, in_y))) << i;
+        }
+#endif
+        for (; i < count; i++)
+        {
+            if (xs[i] >= min_x && xs[i] <= max_x && ys[i] >= min_y && ys[i] <= max_y)
+            {
+                mask |= 1u << i;
+            }
+        }
+        return mask;
+    }
+}
+
+kd_tree::kd_tree(const std::vector<point>& input) : xs(input.size()), ys(input.size()), indices(input.size()), split_value(input.size()), split_y(input.size(), 0)
+{
+    if (input.empty())
+    {
+        return;
+    }
+    //the build moves whole entries around instead of indices into input, so nth_element does not jump around in memory
+    std::vector<entry> entries(input.size());
+    parallel_for(0, input.size(), [&](const std::size_t i) {
+        entries[i] = {input[i].x, input[i].y, static_cast<int>(i)};
+    }, 1 << 14);
+    double min_x = std::numeric_limits<double>::infinity(), min_y = min_x;
+    double max_x = -min_x, max_y = -min_x;
+    for (std::size_t i = 0; i < input.size(); i++)
+    {
+        min_x = std::min(min_x, input[i].x);
+        max_x = std::max(max_x, input[i].x);
+        min_y = std::min(min_y, input[i].y);
+        max_y = std::max(max_y, input[i].y);
+    }
+    int spawn_depth = 0; //levels that still split onto a new thread, enough to give every core a subtree
+    for (unsigned threads = 1; threads < worker_count() && !in_pool_job(); threads *= 2)
+    {
+        spawn_depth++;
+    }
+    build(entries, 0, static_cast<int>(entries.size()), min_x, min_y, max_x, max_y, spawn_depth);
+
+    parallel_for(0, entries.size(), [&](const std::size_t i) {
+        xs[i] = entries[i].x;
+        ys[i] = entries[i].y;
+        indices[i] = entries[i].index;
+    }, 1 << 14);
+}
+
+void kd_tree::build(std::vector<entry>& entries, const int begin, const int end, const double min_x, const double min_y, const double max_x, const double max_y, const int spawn_depth)
+{
+    if (end - begin <= leaf_size)
+    {
+        return;
+    }
+    //split the wider side at the median. the box comes from the splits above instead of measuring every range, it can
+    //be a little larger than the points in it but that only changes which side gets split
+    const bool on_y = max_y - min_y > max_x - min_x;
+    const int middle = begin + (end - begin) / 2;
+    if (on_y)
+    {
+        std::nth_element(entries.begin() + begin, entries.begin() + middle, entries.begin() + end, [](const entry& a, const entry& b) {return a.y < b.y;});
+    }
+    else
+    {
+        std::nth_element(entries.begin() + begin, entries.begin() + middle, entries.begin() + end, [](const entry& a, const entry& b) {return a.x < b.x;});
+    }
+    const double value = on_y ? entries[middle].y : entries[middle].x;
+    split_value[middle] = value;
+    split_y[middle] = on_y ? 1 : 0;
+
+    const auto build_left = [&]() {
+        build(entries, begin, middle, min_x, min_y, on_y ? max_x : value, on_y ? value : max_y, spawn_depth - 1);
+    };
+    const auto build_right = [&]() {
+        build(entries, middle, end, on_y ? min_x : value, on_y ? value : min_y, max_x, max_y, spawn_depth - 1);
+    };
+    if (spawn_depth > 0 && end - begin >= parallel_size)
+    {
+        std::thread left(build_left);
+        build_right();
+        left.join();
+    }
+    else
+    {
+        build_left();
+        build_right();
+    }
+}
+
+void kd_tree::nearest(const point& p, const std::size_t k, std::vector<int>& result) const
+{
+    result.clear();
+    if (k == 0 || indices.empty())
+    {
+        return;
+    }
+    //max-heap on distance of the best k so far
+    thread_local std::vector<std::pair<double, int>> heap;
+    heap.clear();
+    search_nearest(p.x, p.y, 0, static_cast<int>(indices.size()), k, heap);
+    std::sort_heap(heap.begin(), heap.end());
+    for (const std::pair<double, int>& found : heap)
+    {
+        result.push_back(indices[found.second]);
+    }
+}
+
+int kd_tree::nearest(const point& p) const
+{
+    thread_local std::vector<int> result;
+    nearest(p, 1, result);
+    return result.empty() ? -1 : result.front();
+}
+
+void kd_tree::within_radius(const point& p, const double radius, std::vector<int>& result) const
+{
+    result.clear();
+    if (radius >= 0.0 && !indices.empty())
+    {
+        search_radius(p.x, p.y, radius * radius, 0, static_cast<int>(indices.size()), result);
+    }
+}
+
+void kd_tree::within_box(const double min_x, const double min_y, const double max_x, const double max_y, std::vector<int>& result) const
+{
+    result.clear();
+    if (min_x <= max_x && min_y <= max_y && !indices.empty())
+    {
+        search_box(min_x, min_y, max_x, max_y, 0, static_cast<int>(indices.size()), result);
+    }
+}
+
+void kd_tree::search_nearest(const double px, const double py, const int begin, const int end, const std::size_t k, std::vector<std::pair<double, int>>& heap) const
+{
+    if (end - begin <= leaf_size)
+    {
+        double distances[leaf_size];
+        squared_distances(xs.data() + begin, ys.data() + begin, end - begin, px, py, distances);
+        for (int i = 0; i < end - begin; i++)
+        {
+            if (heap.size() < k)
+            {
+                heap.emplace_back(distances[i], begin + i);
+                std::push_heap(heap.begin(), heap.end());
+            }
+            else if (distances[i] < heap.front().first)
+            {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.back() = {distances[i], begin + i};
+                std::push_heap(heap.begin(), heap.end());
+            }
+        }
+        return;
+    }
+    const int middle = begin + (end - begin) / 2;
+    const double offset = (split_y[middle] ? py : px) - split_value[middle];
+    //the side p is on first, the other one only if the splitting line is closer than the worst of the k
+    if (offset < 0)
+    {
+        search_nearest(px, py, begin, middle, k, heap);
+        if (heap.size() < k || offset * offset < heap.front().first)
+        {
+            search_nearest(px, py, middle, end, k, heap);
+        }
+    }
+    else
+    {
+        search_nearest(px, py, middle, end, k, heap);
+        if (heap.size() < k || offset * offset < heap.front().first)
+        {
+            search_nearest(px, py, begin, middle, k, heap);
+        }
+    }
+}
+
+void kd_tree::search_radius(const double px, const double py, const double radius_squared, const int begin, const int end, std::vector<int>& result) const
+{
+    if (end - begin <= leaf_size)
+    {
+        double distances[leaf_size];
+        squared_distances(xs.data() + begin, ys.data() + begin, end - begin, px, py, distances);
+        for (int i = 0; i < end - begin; i++)
+        {
+            if (distances[i] <= radius_squared)
+            {
+                result.push_back(indices[begin + i]);
+            }
+        }
+        return;
+    }
+    const int middle = begin + (end - begin) / 2;
+    const double offset = (split_y[middle] ? py : px) - split_value[middle];
+    if (offset <= 0 || offset * offset <= radius_squared)
+    {
+        search_radius(px, py, radius_squared, begin, middle, result);
+    }
+    if (offset >= 0 || offset * offset <= radius_squared)
+    {
+        search_radius(px, py, radius_squared, middle, end, result);
+    }
+}
+
+void kd_tree::search_box(const double min_x, const double min_y, const double max_x, const double max_y, const int begin, const int end, std::vector<int>& result) const
+{
+    if (end - begin <= leaf_size)
+    {
+        unsigned mask = inside_box(xs.data() + begin, ys.data() + begin, end - begin, min_x, min_y, max_x, max_y);
+        for (int i = begin; mask != 0; i++, mask >>= 1)
+        {
+            if (mask & 1u)
+            {
+                result.push_back(indices[i]);
+            }
+        }
+        return;
+    }
+    const int middle = begin + (end - begin) / 2;
+    const double low = split_y[middle] ? min_y : min_x;
+    const double high = split_y[middle] ? max_y : max_x;
+    if (low <= split_value[middle])
+    {
+        search_box(min_x, min_y, max_x, max_y, begin, middle, result);
+    }
+    if (high >= split_value[middle])
+    {
+        search_box(min_x, min_y, max_x, max_y, middle, end, result);
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+//static 2d kd-tree over a set of points for nearest neighbour, radius and box queries. the tree is implicit, there are no
+//nodes or pointers: the points are reordered so that every range [begin, end) above the leaf size is split at its
+//middle, coordinates <= the split value left of it, >= right. the points of a leaf are next to each other in xs and ys,
+//so a leaf is scanned a few points at a time with simd.
+
+#include "utilities.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class kd_tree {
+    private:
+        struct entry {
+            double x;
+            double y;
+            int index;
+        };
+
+        std::vector<double> xs;             //in tree order
+        std::vector<double> ys;
+        std::vector<int> indices;           //tree order -> index in the input
+        std::vector<double> split_value;    //per range middle: where the range is split
+        std::vector<std::uint8_t> split_y;  //per range middle: split on y instead of x
+
+        void build(std::vector<entry>& entries, int begin, int end, double min_x, double min_y, double max_x, double max_y, int spawn_depth);
+        void search_nearest(double px, double py, int begin, int end, std::size_t k, std::vector<std::pair<double, int>>& heap) const;
+        void search_radius(double px, double py, double radius_squared, int begin, int end, std::vector<int>& result) const;
+        void search_box(double min_x, double min_y, double max_x, double max_y, int begin, int end, std::vector<int>& result) const;
+    public:
+        explicit kd_tree(const std::vector<point>& input); //built on all cores
+        std::size_t size() const {return indices.size();}
+
+        //input indices of the k points closest to p (fewer if there are not that many), closest first
+        void nearest(const point& p, std::size_t k, std::vector<int>& result) const;
+        int nearest(const point& p) const; //input index of the closest point, -1 for an empty tree
+        //input indices of the points at most radius away from p, in no particular order
+        void within_radius(const point& p, double radius, std::vector<int>& result) const;
+        //input indices of the points in [min_x, max_x] x [min_y, max_y], in no particular order
+        void within_box(double min_x, double min_y, double max_x, double max_y, std::vector<int>& result) const;
+};
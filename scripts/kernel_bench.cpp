@@ -0,0 +1,121 @@
+#include "kernel_bench.h"
+#include "geometry_batch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+namespace {
+    //nanoseconds per evaluation of run over repeats passes of count inputs
+    template<typename Run>
+    double time_per_item(const Run& run, const std::size_t count, const int repeats)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++)
+        {
+            run();
+        }
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        return ns / static_cast<double>(count) / static_cast<double>(std::max(repeats, 1));
+    }
+
+    double largest_difference(const std::vector<double>& a, const std::vector<double>& b)
+    {
+        double largest = 0.0;
+        for (std::size_t i = 0; i < a.size(); i++)
+        {
+            largest = std::max(largest, std::abs(a[i] - b[i]));
+        }
+        return largest;
+    }
+
+    void row(std::ostream& os, const char* name, const double scalar_ns, const double batch_ns, const double difference)
+    {
+        os << std::left << std::setw(26) << name << std::right << std::setprecision(2) << std::setw(12) << scalar_ns
+           << std::setw(12) << batch_ns << std::setw(10) << scalar_ns / batch_ns << std::setprecision(3) << std::scientific
+           << std::setw(14) << difference << std::fixed << "\n";
+    }
+}
+
+void benchmark_geometry_kernels(std::ostream& os, const std::size_t count, const int repeats)
+{
+    //sites above a sweepline at y = 700 in an 800 x 600 frame, as the sweep sees them
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<> dist_x(0.0, 800.0);
+    std::uniform_real_distribution<> dist_y(0.0, 600.0);
+    const double sweep_y = 700.0;
+    std::vector<point> arcs, b, c;
+    std::vector<double> xs;
+    for (std::size_t i = 0; i <= count; i++)
+    {
+        arcs.emplace_back(dist_x(gen), dist_y(gen));
+        b.emplace_back(dist_x(gen), dist_y(gen));
+        c.emplace_back(dist_x(gen), dist_y(gen));
+        xs.push_back(dist_x(gen));
+    }
+    std::vector<double> scalar(count), batch(count), scalar_y(count), batch_y(count), scalar_r(count), batch_r(count);
+    std::vector<point> scalar_points(count, point(0, 0)), batch_points(count, point(0, 0));
+
+    const std::ios_base::fmtflags flags = os.flags();
+    os << "batch functions built for " << geometry_instruction_set() << ", " << count << " inputs x " << repeats << "\n";
+    os << std::left << std::setw(26) << "ns per evaluation" << std::right << std::setw(12) << "scalar" << std::setw(12) << "batch"
+       << std::setw(10) << "speedup" << std::setw(14) << "difference" << "\n";
+    os << std::fixed;
+
+    double scalar_ns = time_per_item([&] {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            scalar[i] = calculate_parabola_intersection(arcs[i], arcs[i + 1], sweep_y);
+        }
+    }, count, repeats);
+    double batch_ns = time_per_item([&] {parabola_intersections(arcs.data(), nullptr, count + 1, sweep_y, batch.data());}, count, repeats);
+    row(os, "parabola_intersection", scalar_ns, batch_ns, largest_difference(scalar, batch));
+
+    scalar_ns = time_per_item([&] {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            scalar[i] = calculate_y_parabola(xs[i], arcs[i].x, arcs[i].y, sweep_y);
+        }
+    }, count, repeats);
+    batch_ns = time_per_item([&] {arc_ys(arcs.data(), nullptr, xs.data(), count, sweep_y, batch.data());}, count, repeats);
+    row(os, "y_parabola (a site each)", scalar_ns, batch_ns, largest_difference(scalar, batch));
+
+    scalar_ns = time_per_item([&] {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            scalar[i] = calculate_y_parabola(xs[i], arcs[0].x, arcs[0].y, sweep_y);
+        }
+    }, count, repeats);
+    batch_ns = time_per_item([&] {parabola_ys(xs.data(), count, arcs[0], sweep_y, batch.data());}, count, repeats);
+    row(os, "y_parabola (one site)", scalar_ns, batch_ns, largest_difference(scalar, batch));
+
+    scalar_ns = time_per_item([&] {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const circle result = circumcircle(arcs[i], b[i], c[i]);
+            scalar[i] = result.center.x;
+            scalar_y[i] = result.center.y;
+            scalar_r[i] = result.radius;
+        }
+    }, count, repeats);
+    batch_ns = time_per_item([&] {circumcircles(arcs.data(), b.data(), c.data(), count, batch.data(), batch_y.data(), batch_r.data());}, count, repeats);
+    row(os, "circumcircle", scalar_ns, batch_ns, std::max({largest_difference(scalar, batch), largest_difference(scalar_y, batch_y), largest_difference(scalar_r, batch_r)}));
+
+    scalar_ns = time_per_item([&] {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            scalar_points[i] = mirror_point(arcs[i], b[0], c[0]);
+        }
+    }, count, repeats);
+    batch_ns = time_per_item([&] {mirror_points(arcs.data(), count, b[0], c[0], batch_points.data());}, count, repeats);
+    double difference = 0.0;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        difference = std::max({difference, std::abs(scalar_points[i].x - batch_points[i].x), std::abs(scalar_points[i].y - batch_points[i].y)});
+    }
+    row(os, "mirror_point", scalar_ns, batch_ns, difference);
+    os.flags(flags);
+}
@@ -0,0 +1,9 @@
+#pragma once
+//microbenchmarks of the geometry the sweep calls most often: calculate_parabola_intersection, calculate_y_parabola,
+//circumcircle and mirror_point one call at a time against their batch versions (geometry_batch.h), on count random
+//inputs run repeats times. prints the time per evaluation of both and the largest difference between their results.
+
+#include <cstddef>
+#include <ostream>
+
+void benchmark_geometry_kernels(std::ostream& os, std::size_t count = 1 << 14, int repeats = 200);
@@ -1,5 +1,49 @@
 #include <SDL.h>
 #include "voronoi.h"
+#include "raster.h"
+#include "image_io.h"
+#include "mosaic.h"
+#include "stipple.h"
+#include "sweep_trace.h"
+#include "perf_counters.h"
+#include "kernel_bench.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace {
+    //the same sites every time, for the headless measurements
+    std::vector<point> random_sites(const int count)
+    {
+        std::mt19937 gen(1);
+        std::uniform_real_distribution<> dist_x(0.0, 800.0);
+        std::uniform_real_distribution<> dist_y(0.0, 600.0);
+        std::vector<point> points;
+        points.reserve(static_cast<std::size_t>(std::max(count, 0)));
+        for (int i = 0; i < count; i++)
+        {
+            points.emplace_back(dist_x(gen), dist_y(gen));
+        }
+        return points;
+    }
+
+    //an image side given on the command line, false with a message when it is not a number from 1 to 65536
+    bool parse_side(const char* text, int& side)
+    {
+        char* end = nullptr;
+        const long value = std::strtol(text, &end, 10);
+        if (end == text || *end != '\0' || value < 1 || value > 1 << 16)
+        {
+            std::cerr << "Image size " << text << " is not a number from 1 to 65536" << std::endl;
+            return false;
+        }
+        side = static_cast<int>(value);
+        return true;
+    }
+}
 
 int main(int argc, char* args []) {
     const std::vector<point> in_points{{200,4.1},{100,50.1},{300,60.1},{350,120.7}, {100.6,165}, {10,50.1}, {150, 500.01}, {10,151.1}};
@@ -10,8 +54,100 @@ int main(int argc, char* args []) {
 //(711.426,514.295) (650.218,320.41) (467.657,13.3641) (523.669,153.323) (448.721,544.87) (152.251,78.9697) (579.195,211.085) (240.277,224.197) (504.007,70.9885) (151.551,196.17) (661.531,388.093) (371.691,548.607) (123.261,15.2752) (282.575,7.93121) (157.608,433.955) (201.091,526.177) (456.379,271.536) (173.411,185.978) (141.5,306.842) (798.312,170.935)
     const std::vector<point> in_points7{{282.575, 7.93121}, {467.657, 13.3641}, {123.261, 15.2752}, {504.007, 70.9885}, {152.251, 78.9697}, {523.669, 153.323}, {798.312, 170.935}, {173.411, 185.978}, {151.551, 196.17}, {240.277, 224.197}, {579.195, 211.085}, {456.379, 250.536}};
 
-    voronoi_diagram voronoi;
+    //headless: PROJECT_NAME --export out.png [width height [sweep|cells]], 500 random sites
+    if (argc >= 3 && std::string(args[1]) == "--export")
+    {
+        int width = 1600;
+        int height = 1200;
+        if (argc >= 5 && (!parse_side(args[3], width) || !parse_side(args[4], height)))
+        {
+            return 1;
+        }
+        voronoi_diagram exported(random_sites(500), 800, 600);
+        if (argc >= 6 && std::string(args[5]) == "cells")
+        {
+            exported.set_engine(voronoi_engine::per_cell);
+        }
+        exported.order_sites_spatially();
+        exported.run_voronoi();
+        return rasterize_diagram(exported, width, height).write(args[2]) ? 0 : 1;
+    }
+
+    //headless: PROJECT_NAME --trace trace.json [sites [sample_every]], chrome trace of a sweep over random sites
+    if (argc >= 3 && std::string(args[1]) == "--trace")
+    {
+        const int sites = argc >= 4 ? std::atoi(args[3]) : 100000;
+        trace_options options;
+        //by default about a thousand sites' worth of events are timed, whatever the size of the run
+        options.sample_every = argc >= 5 ? std::strtoull(args[4], nullptr, 10) : std::max(sites / 1000, 1);
+        voronoi_diagram traced(random_sites(sites), 800, 600);
+        sweep_tracer tracer(options);
+        traced.set_tracer(&tracer);
+        traced.run_voronoi();
+        return tracer.write_json(args[2]) ? 0 : 1;
+    }
+
+    //headless: PROJECT_NAME --memory [sites], bytes and allocations per data structure after a sweep over random sites
+    if (argc >= 2 && std::string(args[1]) == "--memory")
+    {
+        const std::vector<point> sites = random_sites(argc >= 3 ? std::atoi(args[2]) : 10000);
+        reset_memory_peaks(); //the peaks of this sweep only
+        voronoi_diagram measured(sites, 800, 600);
+        measured.run_voronoi();
+        print_memory_report(std::cout);
+        return 0;
+    }
+
+    //headless: PROJECT_NAME --perf [sites], hardware counters per stage, per event and per site of a sweep over random sites
+    if (argc >= 2 && std::string(args[1]) == "--perf")
+    {
+        print_measurement(std::cout, measure_sweep(random_sites(argc >= 3 ? std::atoi(args[2]) : 10000), 800, 600));
+        return 0;
+    }
+
+    //headless: PROJECT_NAME --kernels [inputs], scalar geometry functions against their batch versions
+    if (argc >= 2 && std::string(args[1]) == "--kernels")
+    {
+        benchmark_geometry_kernels(std::cout, argc >= 3 ? static_cast<std::size_t>(std::max(std::atoi(args[2]), 1)) : 1 << 14);
+        return 0;
+    }
+
+    //headless: PROJECT_NAME --mosaic in.png out.png [sites]
+    if (argc >= 4 && std::string(args[1]) == "--mosaic")
+    {
+        raster_image source(0, 0);
+        if (!load_image(args[2], source))
+        {
+            return 1;
+        }
+        mosaic_options options;
+        if (argc >= 5)
+        {
+            options.sites = std::atoi(args[4]);
+        }
+        return voronoi_mosaic(source, options).write(args[3]) ? 0 : 1;
+    }
+
+    //headless: PROJECT_NAME --stipple in.png out.png [dots]
+    if (argc >= 4 && std::string(args[1]) == "--stipple")
+    {
+        raster_image source(0, 0);
+        if (!load_image(args[2], source))
+        {
+            return 1;
+        }
+        stipple_options options;
+        if (argc >= 5)
+        {
+            options.dots = std::atoi(args[4]);
+        }
+        const std::vector<point> dots = weighted_stipple(source, options);
+        const int width = static_cast<int>(source.width * options.scale);
+        const int height = static_cast<int>(source.height * options.scale);
+        return render_stipple(dots, width, height, options).write(args[3]) ? 0 : 1;
+    }
 
+    voronoi_diagram voronoi; //500 random sites, made here so the headless modes above do not print them
     voronoi.display_full();
     return 0;
 }
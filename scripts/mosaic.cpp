@@ -0,0 +1,151 @@
+#include "mosaic.h"
+#include "parallel.h"
+#include "scanline.h"
+#include "voronoi.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+namespace {
+    double luminance(const rgba& c)
+    {
+        return 0.299 * c.r + 0.587 * c.g + 0.114 * c.b;
+    }
+
+    std::vector<point> importance_sites(const raster_image& source, const int count, std::mt19937& gen)
+    {
+        //sampling weight of a pixel: gradient magnitude plus a floor so flat areas still get some cells
+        const int w = source.width;
+        const int h = source.height;
+        std::vector<double> cumulative(static_cast<std::size_t>(w) * h);
+        parallel_for(0, static_cast<std::size_t>(h), [&](const std::size_t row) {
+            const int y = static_cast<int>(row);
+            for (int x = 0; x < w; x++)
+            {
+                const double gx = luminance(source.at(std::min(x + 1, w - 1), y)) - luminance(source.at(std::max(x - 1, 0), y));
+                const double gy = luminance(source.at(x, std::min(y + 1, h - 1))) - luminance(source.at(x, std::max(y - 1, 0)));
+                cumulative[row * w + x] = std::sqrt(gx * gx + gy * gy);
+            }
+        });
+        double mean = 0;
+        for (const double g : cumulative) mean += g;
+        mean /= static_cast<double>(cumulative.size());
+        double total = 0;
+        for (double& g : cumulative)
+        {
+            total += g + 0.25 * mean + 1e-9;
+            g = total;
+        }
+
+        std::uniform_real_distribution<> unit(0.0, 1.0);
+        std::vector<point> sites;
+        sites.reserve(static_cast<std::size_t>(count));
+        for (int i = 0; i < count; i++)
+        {
+            const auto pixel = static_cast<std::size_t>(std::upper_bound(cumulative.begin(), cumulative.end(), unit(gen) * total) - cumulative.begin());
+            const std::size_t clamped = std::min(pixel, cumulative.size() - 1);
+            sites.emplace_back(static_cast<double>(clamped % w) + unit(gen), static_cast<double>(clamped / w) + unit(gen));
+        }
+        return sites;
+    }
+}
+
+std::vector<point> place_sites(const raster_image& source, const mosaic_options& options)
+{
+    std::mt19937 gen(options.seed);
+    if (source.width <= 0 || source.height <= 0 || options.sites <= 0)
+    {
+        return {};
+    }
+    if (options.placement == site_placement::importance)
+    {
+        return importance_sites(source, options.sites, gen);
+    }
+
+    std::uniform_real_distribution<> dist_x(0.0, source.width);
+    std::uniform_real_distribution<> dist_y(0.0, source.height);
+    std::vector<point> sites;
+    sites.reserve(static_cast<std::size_t>(options.sites));
+    for (int i = 0; i < options.sites; i++)
+    {
+        sites.emplace_back(dist_x(gen), dist_y(gen));
+    }
+    if (options.placement == site_placement::lloyd)
+    {
+        voronoi_diagram diagram(std::vector<point>{}, source.width, source.height); //reset every iteration, keeps its memory
+        for (int iteration = 0; iteration < options.lloyd_iterations; iteration++)
+        {
+            diagram.reset(sites);
+            diagram.run_voronoi();
+            const std::vector<cell> cells = diagram.build_cells();
+            for (std::size_t i = 0; i < cells.size(); i++)
+            {
+                if (cells[i].polygon.size() >= 3)
+                {
+                    sites[i] = polygon_centroid(cells[i].polygon);
+                }
+            }
+        }
+    }
+    return sites;
+}
+
+raster_image voronoi_mosaic(const raster_image& source, const mosaic_options& options)
+{
+    const std::vector<point> sites = place_sites(source, options);
+    if (sites.empty())
+    {
+        return source;
+    }
+    voronoi_diagram diagram(sites, source.width, source.height);
+    diagram.run_voronoi();
+    const std::vector<cell> cells = diagram.build_cells();
+
+    //average colour of each cell, cells are independent so they are summed in parallel straight from the source
+    std::vector<rgba> colors(cells.size());
+    parallel_for(0, cells.size(), [&](const std::size_t i) {
+        std::uint64_t r = 0, g = 0, b = 0, count = 0;
+        for_each_span(cells[i].polygon, 1.0, 1.0, source.width, 0, source.height, [&](const int y, const int x0, const int x1) {
+            for (int x = x0; x < x1; x++)
+            {
+                const rgba& p = source.at(x, y);
+                r += p.r;
+                g += p.g;
+                b += p.b;
+            }
+            count += static_cast<std::uint64_t>(x1 - x0);
+        });
+        if (count == 0) //cell smaller than a pixel, take the colour under the site
+        {
+            const int x = std::min(std::max(static_cast<int>(cells[i].site.x), 0), source.width - 1);
+            const int y = std::min(std::max(static_cast<int>(cells[i].site.y), 0), source.height - 1);
+            colors[i] = source.at(x, y);
+            return;
+        }
+        colors[i] = {static_cast<std::uint8_t>(r / count), static_cast<std::uint8_t>(g / count), static_cast<std::uint8_t>(b / count), 255};
+    }, 16);
+
+    raster_image mosaic(source.width, source.height, options.outline_color);
+    fill_cells(mosaic, cells, colors, 1.0, 1.0);
+    if (options.outline)
+    {
+        //every shared polygon edge once
+        std::vector<edge> outlines;
+        for (std::size_t i = 0; i < cells.size(); i++)
+        {
+            const std::vector<point>& polygon = cells[i].polygon;
+            for (std::size_t k = 0; k < polygon.size(); k++)
+            {
+                const int neighbor = cells[i].neighbors[k];
+                if (neighbor > static_cast<int>(i))
+                {
+                    outlines.emplace_back(polygon[k], polygon[(k + 1) % polygon.size()], std::make_pair(cells[i].site, cells[neighbor].site));
+                }
+            }
+        }
+        draw_lines(mosaic, outlines, options.outline_color, options.outline_width, 1.0, 1.0);
+    }
+    return mosaic;
+}
@@ -0,0 +1,28 @@
+#pragma once
+//turns an image into a voronoi mosaic: every cell is painted with the average colour of the pixels under it.
+//the averages are integrated over the cell polygons span by span, there is never a per pixel label buffer.
+
+#include "raster.h"
+
+#include <vector>
+
+enum class site_placement {
+    random,     //uniform over the image
+    importance, //denser where the image has detail (luminance gradient)
+    lloyd       //uniform, then moved to their cell centroids a few times for even cells
+};
+
+struct mosaic_options {
+    int sites = 2000;
+    site_placement placement = site_placement::lloyd;
+    int lloyd_iterations = 4;
+    bool outline = true; //dark lines between the cells, stained glass look
+    rgba outline_color{25, 25, 25, 255};
+    int outline_width = 1;
+    unsigned seed = 1;
+};
+
+//sites in pixel coordinates of the source image
+std::vector<point> place_sites(const raster_image& source, const mosaic_options& options);
+
+raster_image voronoi_mosaic(const raster_image& source, const mosaic_options& options = mosaic_options());
@@ -0,0 +1,147 @@
+#pragma once
+//free list allocator for the node based containers of the sweep (std::set of events, half edges and breakpoints).
+//nodes are cut out of large blocks and an erased node goes back on a free list for the next insert, so once the
+//containers have grown the sweep does not call malloc anymore. the blocks are only freed with the pool, all at once.
+//blocks are counted under the memory_tag of the pool (tracked_allocator.h).
+
+#include "tracked_allocator.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+class node_pool {
+    private:
+        struct free_node {
+            free_node* next;
+        };
+        static constexpr std::size_t alignment = alignof(std::max_align_t);
+        static constexpr std::size_t first_block = 64;      //nodes in the first block, every next one is as big as all before
+        static constexpr std::size_t max_block = 1 << 16;
+
+        memory_tag tag;
+        std::size_t node_size = 0; //set by the first allocation, a container only ever asks for one size of node
+        std::vector<std::unique_ptr<unsigned char[]>> blocks;
+        std::size_t capacity = 0;
+        free_node* free_list = nullptr;
+
+        void grow()
+        {
+            //copies, std::min and std::max take references and C++14 has no definition of the static members to bind to
+            const std::size_t smallest = first_block;
+            const std::size_t largest = max_block;
+            const std::size_t count = std::min(std::max(smallest, capacity), largest);
+            blocks.emplace_back(new unsigned char[count * node_size]); //new[] of char is aligned for any type
+            record_allocation(tag, count * node_size);
+            unsigned char* begin = blocks.back().get();
+            //pushed back to front, so the nodes are handed out in address order
+            for (std::size_t i = count; i-- > 0;)
+            {
+                free_node* node = reinterpret_cast<free_node*>(begin + i * node_size);
+                node->next = free_list;
+                free_list = node;
+            }
+            capacity += count;
+        }
+    public:
+        explicit node_pool(const memory_tag tag) : tag(tag) {}
+        node_pool(const node_pool&) = delete;
+        node_pool& operator=(const node_pool&) = delete;
+        ~node_pool()
+        {
+            if (!blocks.empty())
+            {
+                record_free(tag, capacity * node_size, blocks.size());
+            }
+        }
+
+        void* allocate(const std::size_t bytes)
+        {
+            if (node_size == 0)
+            {
+                node_size = (std::max(bytes, sizeof(free_node)) + alignment - 1) / alignment * alignment;
+            }
+            if (bytes > node_size)
+            {
+                record_allocation(tag, bytes);
+                return ::operator new(bytes);
+            }
+            if (free_list == nullptr)
+            {
+                grow();
+            }
+            free_node* node = free_list;
+            free_list = node->next;
+            return node;
+        }
+
+        void deallocate(void* memory, const std::size_t bytes)
+        {
+            if (bytes > node_size)
+            {
+                record_free(tag, bytes);
+                ::operator delete(memory);
+                return;
+            }
+            free_node* node = static_cast<free_node*>(memory);
+            node->next = free_list;
+            free_list = node;
+        }
+};
+
+//std allocator on a node_pool. copies share the pool, a container that is copied gets a new one. the pool lives until
+//the last container using it is gone, so the blocks go when the container does
+template<typename T, memory_tag Tag>
+class pool_allocator {
+    private:
+        std::shared_ptr<node_pool> pool;
+
+        template<typename U, memory_tag>
+        friend class pool_allocator;
+    public:
+        using value_type = T;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+        using is_always_equal = std::false_type;
+        template<typename U>
+        struct rebind {
+            using other = pool_allocator<U, Tag>;
+        };
+
+        pool_allocator() : pool(std::make_shared<node_pool>(Tag)) {}
+        pool_allocator(const pool_allocator&) = default; //no move, a moved from container still needs its pool
+        pool_allocator& operator=(const pool_allocator&) = default;
+        template<typename U>
+        pool_allocator(const pool_allocator<U, Tag>& other) : pool(other.pool) {}
+
+        pool_allocator select_on_container_copy_construction() const {return {};}
+
+        T* allocate(const std::size_t n)
+        {
+            if (n != 1)
+            {
+                record_allocation(Tag, n * sizeof(T));
+                return static_cast<T*>(::operator new(n * sizeof(T)));
+            }
+            return static_cast<T*>(pool->allocate(sizeof(T)));
+        }
+
+        void deallocate(T* memory, const std::size_t n)
+        {
+            if (n != 1)
+            {
+                record_free(Tag, n * sizeof(T));
+                ::operator delete(memory);
+                return;
+            }
+            pool->deallocate(memory, sizeof(T));
+        }
+
+        template<typename U>
+        bool operator==(const pool_allocator<U, Tag>& other) const {return pool == other.pool;}
+        template<typename U>
+        bool operator!=(const pool_allocator<U, Tag>& other) const {return pool != other.pool;}
+};
@@ -0,0 +1,60 @@
+#pragma once
+//small helpers for splitting independent work over all cores
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+inline unsigned worker_count()
+{
+    const unsigned hardware = std::thread::hardware_concurrency();
+    return hardware == 0 ? 1 : hardware;
+}
+
+//true while a task_pool job runs on this thread. parallel_for then stays on the calling thread, the pool already has
+//every core busy with other jobs
+inline bool& in_pool_job()
+{
+    thread_local bool inside = false;
+    return inside;
+}
+
+//calls fn(i) for every i in [begin, end). indices are handed out in chunks of grain from a shared counter,
+//so uneven work (tiles with many edges, big cells) still keeps every thread busy.
+template<typename Fn>
+void parallel_for(const std::size_t begin, const std::size_t end, const Fn& fn, const std::size_t grain = 1)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+    const std::size_t chunk = std::max<std::size_t>(grain, 1);
+    const std::size_t chunks = (end - begin + chunk - 1) / chunk;
+    const unsigned threads = in_pool_job() ? 1 : static_cast<unsigned>(std::min<std::size_t>(worker_count(), chunks));
+
+    std::atomic<std::size_t> next{begin};
+    const auto work = [&]() {
+        for (std::size_t first = next.fetch_add(chunk); first < end; first = next.fetch_add(chunk))
+        {
+            const std::size_t last = std::min(first + chunk, end);
+            for (std::size_t i = first; i < last; i++)
+            {
+                fn(i);
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; t++)
+    {
+        pool.emplace_back(work);
+    }
+    work(); //the calling thread works too
+    for (std::thread& thread : pool)
+    {
+        thread.join();
+    }
+}
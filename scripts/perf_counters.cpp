@@ -0,0 +1,278 @@
+#include "perf_counters.h"
+#include "voronoi.h"
+
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#ifdef __linux__
+    perf_event_attr counter_attr(const perf_counter counter)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        switch (counter)
+        {
+            case perf_counter::cycles: attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+            case perf_counter::instructions: attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+            case perf_counter::l1d_misses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            case perf_counter::llc_misses: attr.config = PERF_COUNT_HW_CACHE_MISSES; break; //the last level on most cpus
+            default: attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+        }
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_kernel = 1; //also what an unprivileged process may count
+        attr.exclude_hv = 1;
+        return attr;
+    }
+#endif
+
+    std::uint64_t elapsed_ns(const std::chrono::steady_clock::time_point since)
+    {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - since).count());
+    }
+}
+
+const char* perf_counter_name(const perf_counter counter)
+{
+    switch (counter)
+    {
+        case perf_counter::cycles: return "cycles";
+        case perf_counter::instructions: return "instructions";
+        case perf_counter::l1d_misses: return "l1d_misses";
+        case perf_counter::llc_misses: return "llc_misses";
+        case perf_counter::branch_misses: return "branch_misses";
+        default: return "unknown";
+    }
+}
+
+perf_values& perf_values::operator+=(const perf_values& other)
+{
+    for (std::size_t i = 0; i < counter_count; i++)
+    {
+        counts[i] += other.counts[i];
+    }
+    wall_ns += other.wall_ns;
+    return *this;
+}
+
+perf_values perf_values::operator-(const perf_values& earlier) const
+{
+    perf_values difference;
+    for (std::size_t i = 0; i < counter_count; i++)
+    {
+        difference.counts[i] = counts[i] >= earlier.counts[i] ? counts[i] - earlier.counts[i] : 0; //scaling can step back a little
+    }
+    difference.wall_ns = wall_ns - earlier.wall_ns;
+    return difference;
+}
+
+perf_counters::perf_counters()
+{
+    fds.fill(-1);
+    slots.fill(-1);
+#ifdef __linux__
+    for (std::size_t i = 0; i < perf_values::counter_count; i++)
+    {
+        perf_event_attr attr = counter_attr(static_cast<perf_counter>(i));
+        attr.disabled = leader == -1 ? 1 : 0; //the members follow the leader
+        const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+        if (fd == -1)
+        {
+            if (problem.empty())
+            {
+                problem = std::string(perf_counter_name(static_cast<perf_counter>(i))) + ": " + std::strerror(errno);
+                if (errno == EACCES || errno == EPERM)
+                {
+                    problem += " (see /proc/sys/kernel/perf_event_paranoid)";
+                }
+                else if (errno == ENOENT || errno == ENODEV || errno == EOPNOTSUPP)
+                {
+                    problem += " (not on this cpu, or a virtual machine without hardware counters)";
+                }
+            }
+            continue;
+        }
+        if (leader == -1)
+        {
+            leader = fd;
+        }
+        fds[i] = fd;
+        slots[i] = static_cast<int>(opened++);
+    }
+    if (leader != -1)
+    {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#else
+    problem = "hardware counters are only read on linux";
+#endif
+    start = std::chrono::steady_clock::now();
+}
+
+perf_counters::~perf_counters()
+{
+#ifdef __linux__
+    for (const int fd : fds)
+    {
+        if (fd != -1)
+        {
+            close(fd);
+        }
+    }
+#endif
+}
+
+perf_values perf_counters::read() const
+{
+    perf_values values;
+    values.wall_ns = elapsed_ns(start);
+#ifdef __linux__
+    if (leader == -1)
+    {
+        return values;
+    }
+    std::uint64_t buffer[3 + perf_values::counter_count]; //count, time enabled, time running, then the values
+    if (::read(leader, buffer, sizeof(buffer)) < static_cast<ssize_t>(3 * sizeof(std::uint64_t)) || buffer[2] == 0)
+    {
+        return values; //not read, or never got onto the hardware so far
+    }
+    const double scale = static_cast<double>(buffer[1]) / static_cast<double>(buffer[2]);
+    for (std::size_t i = 0; i < perf_values::counter_count; i++)
+    {
+        if (slots[i] >= 0 && static_cast<std::uint64_t>(slots[i]) < buffer[0])
+        {
+            values.counts[i] = static_cast<std::uint64_t>(static_cast<double>(buffer[3 + slots[i]]) * scale);
+        }
+    }
+#endif
+    return values;
+}
+
+const char* sweep_stage_name(const sweep_stage stage)
+{
+    switch (stage)
+    {
+        case sweep_stage::prepare: return "prepare";
+        case sweep_stage::site_events: return "site_events";
+        case sweep_stage::circle_events: return "circle_events";
+        case sweep_stage::complete_edges: return "complete_edges";
+        default: return "unknown";
+    }
+}
+
+sweep_measurement measure_sweep(const std::vector<point>& sites, const int width, const int height)
+{
+    sweep_measurement measurement;
+    measurement.sites = sites.size();
+    const perf_counters counters;
+    for (std::size_t i = 0; i < perf_values::counter_count; i++)
+    {
+        measurement.counted[i] = counters.has(static_cast<perf_counter>(i));
+    }
+    measurement.unavailable = counters.why_unavailable();
+
+    const auto add = [&](const sweep_stage stage, const perf_values& difference) {
+        measurement.stages[static_cast<std::size_t>(stage)] += difference;
+        measurement.calls[static_cast<std::size_t>(stage)]++;
+    };
+
+    perf_values last = counters.read();
+    voronoi_diagram diagram(sites, width, height); //copying the sites and the sort
+    perf_values now = counters.read();
+    add(sweep_stage::prepare, now - last);
+    last = now;
+
+    //the callback comes after every event, an event that took a site moved sites_done on
+    std::size_t sites_done = 0;
+    try
+    {
+        diagram.run_voronoi([&](const sweep_progress& progress) {
+            now = counters.read();
+            add(progress.sites_done != sites_done ? sweep_stage::site_events : sweep_stage::circle_events, now - last);
+            sites_done = progress.sites_done;
+            last = counters.read(); //the bookkeeping here is left out
+            return true;
+        });
+    }
+    catch (const std::invalid_argument& e)
+    {
+        std::cerr << "The sweep gave up: " << e.what() << std::endl;
+    }
+    now = counters.read();
+    add(sweep_stage::complete_edges, now - last);
+    return measurement;
+}
+
+void print_measurement(std::ostream& os, const sweep_measurement& measurement)
+{
+    const std::ios_base::fmtflags flags = os.flags();
+    const std::size_t site_stage = static_cast<std::size_t>(sweep_stage::site_events);
+    const std::size_t circle_stage = static_cast<std::size_t>(sweep_stage::circle_events);
+    const std::uint64_t events = measurement.calls[site_stage] + measurement.calls[circle_stage];
+    os << measurement.sites << " sites, " << events << " events (" << measurement.calls[circle_stage] << " from the queue)\n";
+    if (!measurement.unavailable.empty())
+    {
+        os << "not counted: " << measurement.unavailable << "\n";
+    }
+
+    const std::size_t cycles = static_cast<std::size_t>(perf_counter::cycles);
+    const std::size_t instructions = static_cast<std::size_t>(perf_counter::instructions);
+    os << std::left << std::setw(16) << "per" << std::right << std::setw(10) << "calls" << std::setw(12) << "ns";
+    for (std::size_t i = 0; i < perf_values::counter_count; i++)
+    {
+        os << std::setw(15) << perf_counter_name(static_cast<perf_counter>(i));
+    }
+    os << std::setw(8) << "ipc" << "\n";
+    os << std::fixed << std::setprecision(1);
+    const auto row = [&](const char* name, const perf_values& values, const std::uint64_t calls) {
+        const double per = calls == 0 ? 0.0 : 1.0 / static_cast<double>(calls);
+        os << std::left << std::setw(16) << name << std::right << std::setw(10) << calls << std::setw(12) << static_cast<double>(values.wall_ns) * per;
+        for (std::size_t i = 0; i < perf_values::counter_count; i++)
+        {
+            if (measurement.counted[i])
+            {
+                os << std::setw(15) << static_cast<double>(values.counts[i]) * per;
+            }
+            else
+            {
+                os << std::setw(15) << "-";
+            }
+        }
+        if (measurement.counted[cycles] && measurement.counted[instructions] && values.counts[cycles] != 0)
+        {
+            os << std::setw(8) << std::setprecision(2) << static_cast<double>(values.counts[instructions]) / static_cast<double>(values.counts[cycles]) << std::setprecision(1);
+        }
+        else
+        {
+            os << std::setw(8) << "-";
+        }
+        os << "\n";
+    };
+
+    perf_values event_total = measurement.stages[site_stage];
+    event_total += measurement.stages[circle_stage];
+    perf_values total;
+    for (std::size_t stage = 0; stage < sweep_measurement::stage_count; stage++)
+    {
+        row(sweep_stage_name(static_cast<sweep_stage>(stage)), measurement.stages[stage], measurement.calls[stage]);
+        total += measurement.stages[stage];
+    }
+    row("event", event_total, events);
+    row("site", total, measurement.sites);
+    os.flags(flags);
+}
@@ -0,0 +1,66 @@
+#pragma once
+//hardware counters around the sweep. perf_counters reads cycles, instructions, l1 data cache misses, last level cache
+//misses and branch misses of the calling thread, user space only, through perf_event_open (linux). measure_sweep
+//builds a diagram with the counters read after the sites are prepared, after every event and after complete_edges,
+//so what an event costs can be told apart by kind. where the counters can not be opened (other systems, a virtual
+//machine without a PMU, perf_event_paranoid) the wall clock time is still measured and the report says why.
+
+#include "utilities.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum class perf_counter : std::uint8_t {cycles, instructions, l1d_misses, llc_misses, branch_misses, count};
+const char* perf_counter_name(perf_counter counter);
+
+struct perf_values { //a reading, or what happened between two
+    static constexpr std::size_t counter_count = static_cast<std::size_t>(perf_counter::count);
+    std::array<std::uint64_t, counter_count> counts{};
+    std::uint64_t wall_ns = 0;
+
+    perf_values& operator+=(const perf_values& other);
+    perf_values operator-(const perf_values& earlier) const;
+};
+
+class perf_counters {
+    private:
+        int leader = -1; //the counters are one group, read together in one call
+        std::array<int, perf_values::counter_count> fds;
+        std::array<int, perf_values::counter_count> slots; //position in a group read, -1 if the counter did not open
+        std::size_t opened = 0;
+        std::string problem;
+        std::chrono::steady_clock::time_point start;
+    public:
+        perf_counters(); //counting starts here
+        ~perf_counters();
+        perf_counters(const perf_counters&) = delete;
+        perf_counters& operator=(const perf_counters&) = delete;
+
+        bool available() const {return opened != 0;}
+        bool has(const perf_counter counter) const {return slots[static_cast<std::size_t>(counter)] >= 0;}
+        const std::string& why_unavailable() const {return problem;} //why some or all counters did not open
+        //counts so far, scaled up by the time they ran if the kernel had to share the hardware between more counters
+        perf_values read() const;
+};
+
+enum class sweep_stage : std::uint8_t {prepare, site_events, circle_events, complete_edges, count}; //circle_events: whatever comes from the queue, weighted sites too
+const char* sweep_stage_name(sweep_stage stage);
+
+struct sweep_measurement {
+    static constexpr std::size_t stage_count = static_cast<std::size_t>(sweep_stage::count);
+    std::array<perf_values, stage_count> stages;
+    std::array<std::uint64_t, stage_count> calls{};
+    std::size_t sites = 0;
+    std::array<bool, perf_values::counter_count> counted{}; //which counters are in the values
+    std::string unavailable;
+};
+
+//builds the sweep diagram of sites in [0,width] x [0,height], measuring as it goes
+sweep_measurement measure_sweep(const std::vector<point>& sites, int width, int height);
+//per call of every stage, then per event and per site over the whole run
+void print_measurement(std::ostream& os, const sweep_measurement& measurement);
@@ -0,0 +1,91 @@
+#pragma once
+//stable lsd radix sort with the work of every pass split over all cores
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+//unsigned key in the same order as the double, for radix_sort. -0.0 and 0.0 get the same key
+inline std::uint64_t radix_key(double value)
+{
+    value += 0.0; //turns -0.0 into 0.0
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    constexpr std::uint64_t sign = std::uint64_t{1} << 63;
+    return (bits & sign) ? ~bits : bits | sign;
+}
+
+//sorts items by key(item), an unsigned integer of key_bits bits, keeping equal keys in the order they were in. one pass
+//per 8 bits: every core counts the digits of its own slice, then moves that slice to where the counts put it. passes in
+//which every item has the same digit are skipped, so keys that only use a few bits cost few passes.
+//buffer is scratch space, passing the same one every time saves allocating it
+template<typename T, typename Key>
+void radix_sort(std::vector<T>& items, const Key& key, const int key_bits, std::vector<T>& buffer)
+{
+    constexpr int digit_bits = 8;
+    constexpr std::size_t buckets = std::size_t{1} << digit_bits;
+    constexpr std::size_t min_slice = 1 << 14; //smaller slices are not worth a thread
+    const std::size_t count = items.size();
+    if (count < 2)
+    {
+        return;
+    }
+    const std::size_t slices = std::max<std::size_t>(1, std::min<std::size_t>(worker_count(), count / min_slice));
+    const auto slice_begin = [&](const std::size_t slice) {return count * slice / slices;};
+
+    buffer.resize(count);
+    //per slice digit counts, kept from call to call. a reference because the workers must see this thread's copy
+    thread_local std::vector<std::array<std::size_t, buckets>> kept_offsets;
+    std::vector<std::array<std::size_t, buckets>>& offsets = kept_offsets;
+    offsets.resize(slices);
+    for (int shift = 0; shift < key_bits; shift += digit_bits)
+    {
+        parallel_for(0, slices, [&](const std::size_t slice) {
+            std::array<std::size_t, buckets>& counts = offsets[slice];
+            counts.fill(0);
+            for (std::size_t i = slice_begin(slice); i < slice_begin(slice + 1); i++)
+            {
+                counts[(static_cast<std::uint64_t>(key(items[i])) >> shift) & (buckets - 1)]++;
+            }
+        });
+        //digit by digit and within a digit slice by slice, which keeps the sort stable
+        std::size_t offset = 0;
+        bool all_same = false;
+        for (std::size_t digit = 0; digit < buckets && !all_same; digit++)
+        {
+            std::size_t total = 0;
+            for (std::size_t slice = 0; slice < slices; slice++)
+            {
+                const std::size_t counted = offsets[slice][digit];
+                offsets[slice][digit] = offset;
+                offset += counted;
+                total += counted;
+            }
+            all_same = total == count;
+        }
+        if (all_same)
+        {
+            continue;
+        }
+        parallel_for(0, slices, [&](const std::size_t slice) {
+            std::array<std::size_t, buckets>& next = offsets[slice];
+            for (std::size_t i = slice_begin(slice); i < slice_begin(slice + 1); i++)
+            {
+                buffer[next[(static_cast<std::uint64_t>(key(items[i])) >> shift) & (buckets - 1)]++] = items[i];
+            }
+        });
+        items.swap(buffer);
+    }
+}
+
+template<typename T, typename Key>
+void radix_sort(std::vector<T>& items, const Key& key, const int key_bits)
+{
+    std::vector<T> buffer;
+    radix_sort(items, key, key_bits, buffer);
+}
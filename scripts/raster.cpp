@@ -0,0 +1,388 @@
+#include "raster.h"
+#include "parallel.h"
+#include "scanline.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    constexpr int tile_size = 64;
+
+    struct pixel_rect {
+        int x0, y0, x1, y1; //half open
+    };
+
+    void stamp(raster_image& image, const pixel_rect& tile, const int x, const int y, const int radius, const rgba color)
+    {
+        const int x0 = std::max(x - radius, tile.x0);
+        const int x1 = std::min(x + radius + 1, tile.x1);
+        const int y0 = std::max(y - radius, tile.y0);
+        const int y1 = std::min(y + radius + 1, tile.y1);
+        for (int py = y0; py < y1; py++)
+        {
+            for (int px = x0; px < x1; px++)
+            {
+                image.at(px, py) = color;
+            }
+        }
+    }
+
+    //Liang-Barsky clip of the segment a-b to the rectangle, false if nothing is left
+    bool clip_segment(double& ax, double& ay, double& bx, double& by, const double x0, const double y0, const double x1, const double y1)
+    {
+        double t0 = 0.0;
+        double t1 = 1.0;
+        const double dx = bx - ax;
+        const double dy = by - ay;
+        const std::array<double, 4> p{-dx, dx, -dy, dy};
+        const std::array<double, 4> q{ax - x0, x1 - ax, ay - y0, y1 - ay};
+        for (int i = 0; i < 4; i++)
+        {
+            if (p[i] == 0)
+            {
+                if (q[i] < 0) return false;
+                continue;
+            }
+            const double t = q[i] / p[i];
+            if (p[i] < 0) t0 = std::max(t0, t);
+            else t1 = std::min(t1, t);
+            if (t0 > t1) return false;
+        }
+        bx = ax + t1 * dx;
+        by = ay + t1 * dy;
+        ax = ax + t0 * dx;
+        ay = ay + t0 * dy;
+        return true;
+    }
+
+    void draw_segment(raster_image& image, const pixel_rect& tile, double ax, double ay, double bx, double by, const int radius, const rgba color)
+    {
+        const double margin = radius + 1.0;
+        if (!clip_segment(ax, ay, bx, by, tile.x0 - margin, tile.y0 - margin, tile.x1 + margin, tile.y1 + margin))
+        {
+            return;
+        }
+        const int steps = static_cast<int>(std::ceil(std::max(std::abs(bx - ax), std::abs(by - ay))));
+        for (int i = 0; i <= steps; i++)
+        {
+            const double t = steps == 0 ? 0.0 : static_cast<double>(i) / steps;
+            stamp(image, tile, static_cast<int>(std::floor(ax + (bx - ax) * t)), static_cast<int>(std::floor(ay + (by - ay) * t)), radius, color);
+        }
+    }
+
+    //adds id to every tile the thick segment passes through. the segment is walked in pieces no longer than a tile,
+    //so each piece only touches a couple of tiles even for long diagonal edges.
+    void bin_segment(std::vector<std::vector<std::uint32_t>>& bins, const int tiles_x, const int tiles_y, const std::uint32_t id,
+                     const double ax, const double ay, const double bx, const double by, const double margin)
+    {
+        const double length = std::max(std::abs(bx - ax), std::abs(by - ay));
+        const int pieces = std::max(1, static_cast<int>(std::ceil(length / tile_size)));
+        for (int k = 0; k < pieces; k++)
+        {
+            const double t0 = static_cast<double>(k) / pieces;
+            const double t1 = static_cast<double>(k + 1) / pieces;
+            const double px0 = ax + (bx - ax) * t0, py0 = ay + (by - ay) * t0;
+            const double px1 = ax + (bx - ax) * t1, py1 = ay + (by - ay) * t1;
+            const int tx0 = std::max(static_cast<int>(std::floor((std::min(px0, px1) - margin) / tile_size)), 0);
+            const int tx1 = std::min(static_cast<int>(std::floor((std::max(px0, px1) + margin) / tile_size)), tiles_x - 1);
+            const int ty0 = std::max(static_cast<int>(std::floor((std::min(py0, py1) - margin) / tile_size)), 0);
+            const int ty1 = std::min(static_cast<int>(std::floor((std::max(py0, py1) + margin) / tile_size)), tiles_y - 1);
+            for (int ty = ty0; ty <= ty1; ty++)
+            {
+                for (int tx = tx0; tx <= tx1; tx++)
+                {
+                    std::vector<std::uint32_t>& bin = bins[static_cast<std::size_t>(ty) * tiles_x + tx];
+                    if (bin.empty() || bin.back() != id)
+                    {
+                        bin.push_back(id);
+                    }
+                }
+            }
+        }
+    }
+
+    //png pieces
+    std::uint32_t crc32(const std::uint32_t crc, const unsigned char* data, const std::size_t length)
+    {
+        static const std::array<std::uint32_t, 256> table = []() {
+            std::array<std::uint32_t, 256> t{};
+            for (std::uint32_t n = 0; n < 256; n++)
+            {
+                std::uint32_t c = n;
+                for (int k = 0; k < 8; k++)
+                {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                t[n] = c;
+            }
+            return t;
+        }();
+        std::uint32_t c = crc ^ 0xFFFFFFFFu;
+        for (std::size_t i = 0; i < length; i++)
+        {
+            c = table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+        }
+        return c ^ 0xFFFFFFFFu;
+    }
+
+    void put_u32(std::vector<unsigned char>& out, const std::uint32_t value)
+    {
+        out.push_back(static_cast<unsigned char>(value >> 24));
+        out.push_back(static_cast<unsigned char>(value >> 16));
+        out.push_back(static_cast<unsigned char>(value >> 8));
+        out.push_back(static_cast<unsigned char>(value));
+    }
+
+    void write_chunk(std::ofstream& out, const char* type, const std::vector<unsigned char>& data)
+    {
+        std::vector<unsigned char> head;
+        put_u32(head, static_cast<std::uint32_t>(data.size()));
+        head.insert(head.end(), type, type + 4);
+        std::uint32_t crc = crc32(0, head.data() + 4, 4);
+        crc = crc32(crc, data.data(), data.size());
+        std::vector<unsigned char> tail;
+        put_u32(tail, crc);
+        out.write(reinterpret_cast<const char*>(head.data()), static_cast<std::streamsize>(head.size()));
+        out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        out.write(reinterpret_cast<const char*>(tail.data()), static_cast<std::streamsize>(tail.size()));
+    }
+}
+
+raster_image::raster_image(const int width, const int height, const rgba fill)
+    : width(width > 0 && height > 0 ? width : 0), height(width > 0 && height > 0 ? height : 0),
+      pixels(static_cast<std::size_t>(this->width) * static_cast<std::size_t>(this->height), fill) {}
+
+bool raster_image::write_ppm(const std::string& path) const
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "Could not open " << path << " for writing" << std::endl;
+        return false;
+    }
+    out << "P6\n" << width << " " << height << "\n255\n";
+    std::vector<unsigned char> row(static_cast<std::size_t>(width) * 3);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const rgba& c = at(x, y);
+            row[x*3] = c.r;
+            row[x*3 + 1] = c.g;
+            row[x*3 + 2] = c.b;
+        }
+        out.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+    }
+    return static_cast<bool>(out);
+}
+
+bool raster_image::write_png(const std::string& path) const
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "Could not open " << path << " for writing" << std::endl;
+        return false;
+    }
+    static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    out.write(reinterpret_cast<const char*>(signature), 8);
+
+    std::vector<unsigned char> ihdr;
+    put_u32(ihdr, static_cast<std::uint32_t>(width));
+    put_u32(ihdr, static_cast<std::uint32_t>(height));
+    ihdr.insert(ihdr.end(), {8, 6, 0, 0, 0}); //8 bit rgba, no interlace
+    write_chunk(out, "IHDR", ihdr);
+
+    //the zlib stream is made of stored deflate blocks, split over IDAT chunks of about a megabyte
+    constexpr std::size_t max_block = 65535;
+    constexpr std::size_t idat_size = 1 << 20;
+    std::vector<unsigned char> idat = {0x78, 0x01};
+    std::vector<unsigned char> block;
+    block.reserve(max_block);
+    std::uint32_t adler_a = 1;
+    std::uint32_t adler_b = 0;
+
+    const auto emit_block = [&](const bool last) {
+        idat.push_back(last ? 1 : 0);
+        const auto length = static_cast<std::uint16_t>(block.size());
+        idat.push_back(static_cast<unsigned char>(length & 0xFF));
+        idat.push_back(static_cast<unsigned char>(length >> 8));
+        idat.push_back(static_cast<unsigned char>(~length & 0xFF));
+        idat.push_back(static_cast<unsigned char>((~length >> 8) & 0xFF));
+        idat.insert(idat.end(), block.begin(), block.end());
+        block.clear();
+        if (idat.size() >= idat_size)
+        {
+            write_chunk(out, "IDAT", idat);
+            idat.clear();
+        }
+    };
+    const auto put = [&](const unsigned char* data, std::size_t length) {
+        for (std::size_t i = 0; i < length; i++)
+        {
+            adler_a = (adler_a + data[i]) % 65521;
+            adler_b = (adler_b + adler_a) % 65521;
+        }
+        while (length > 0)
+        {
+            const std::size_t take = std::min(length, max_block - block.size());
+            block.insert(block.end(), data, data + take);
+            data += take;
+            length -= take;
+            if (block.size() == max_block)
+            {
+                emit_block(false);
+            }
+        }
+    };
+
+    const unsigned char filter = 0;
+    for (int y = 0; y < height; y++)
+    {
+        put(&filter, 1);
+        put(reinterpret_cast<const unsigned char*>(&at(0, y)), static_cast<std::size_t>(width) * sizeof(rgba));
+    }
+    emit_block(true);
+    put_u32(idat, (adler_b << 16) | adler_a);
+    write_chunk(out, "IDAT", idat);
+    write_chunk(out, "IEND", {});
+    return static_cast<bool>(out);
+}
+
+bool raster_image::write(const std::string& path) const
+{
+    if (width <= 0 || height <= 0)
+    {
+        std::cerr << "Could not write " << path << ", the image is empty" << std::endl;
+        return false;
+    }
+    const std::size_t dot = path.find_last_of('.');
+    std::string extension = dot == std::string::npos ? "" : path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](const unsigned char c) {return static_cast<char>(std::tolower(c));});
+    if (extension == "png")
+    {
+        return write_png(path);
+    }
+    if (extension == "ppm")
+    {
+        return write_ppm(path);
+    }
+    std::cerr << "Unknown image format for " << path << ", use .png or .ppm" << std::endl;
+    return false;
+}
+
+rgba cell_color(const std::size_t index)
+{
+    std::uint64_t h = index * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+    //pastel, so edges and sites stay visible on top
+    return {static_cast<std::uint8_t>(110 + (h & 0x7F)), static_cast<std::uint8_t>(110 + ((h >> 8) & 0x7F)), static_cast<std::uint8_t>(110 + ((h >> 16) & 0x7F)), 255};
+}
+
+void fill_cells(raster_image& image, const std::vector<cell>& cells, const std::vector<rgba>& colors, const double scale_x, const double scale_y)
+{
+    //horizontal bands are filled in parallel, each band walks the cells overlapping it
+    constexpr int band_height = 32;
+    const int bands = (image.height + band_height - 1) / band_height;
+    std::vector<std::vector<std::uint32_t>> band_cells(static_cast<std::size_t>(std::max(bands, 0)));
+    for (std::uint32_t i = 0; i < cells.size(); i++)
+    {
+        int first, last;
+        polygon_rows(cells[i].polygon, scale_y, first, last);
+        first = std::max(first, 0);
+        last = std::min(last, image.height);
+        for (int band = first / band_height; first < last && band <= (last - 1) / band_height; band++)
+        {
+            band_cells[band].push_back(i);
+        }
+    }
+    parallel_for(0, band_cells.size(), [&](const std::size_t band) {
+        const int row_begin = static_cast<int>(band) * band_height;
+        const int row_end = std::min(row_begin + band_height, image.height);
+        for (const std::uint32_t i : band_cells[band])
+        {
+            const rgba color = colors[i];
+            for_each_span(cells[i].polygon, scale_x, scale_y, image.width, row_begin, row_end, [&](const int y, const int x0, const int x1) {
+                std::fill(&image.at(x0, y), &image.at(x0, y) + (x1 - x0), color);
+            });
+        }
+    });
+}
+
+void draw_lines(raster_image& image, const std::vector<edge>& lines, const rgba color, const int line_width, const double scale_x, const double scale_y)
+{
+    const int tiles_x = (image.width + tile_size - 1) / tile_size;
+    const int tiles_y = (image.height + tile_size - 1) / tile_size;
+    const int radius = std::max(line_width, 1) / 2;
+    std::vector<std::vector<std::uint32_t>> bins(static_cast<std::size_t>(tiles_x) * tiles_y);
+    for (std::uint32_t i = 0; i < lines.size(); i++)
+    {
+        bin_segment(bins, tiles_x, tiles_y, i, lines[i].start.x * scale_x, lines[i].start.y * scale_y,
+                    lines[i].end.x * scale_x, lines[i].end.y * scale_y, radius + 1.0);
+    }
+    parallel_for(0, bins.size(), [&](const std::size_t tile_index) {
+        const int tx = static_cast<int>(tile_index % tiles_x);
+        const int ty = static_cast<int>(tile_index / tiles_x);
+        const pixel_rect tile{tx * tile_size, ty * tile_size, std::min((tx + 1) * tile_size, image.width), std::min((ty + 1) * tile_size, image.height)};
+        for (const std::uint32_t i : bins[tile_index])
+        {
+            draw_segment(image, tile, lines[i].start.x * scale_x, lines[i].start.y * scale_y,
+                         lines[i].end.x * scale_x, lines[i].end.y * scale_y, radius, color);
+        }
+    });
+}
+
+raster_image rasterize_diagram(const voronoi_diagram& diagram, const int width, const int height, const raster_style& style)
+{
+    raster_image image(width, height, style.background);
+    if (width <= 0 || height <= 0)
+    {
+        return image;
+    }
+    const std::vector<point>& sites = diagram.get_input_points();
+    const double scale_x = static_cast<double>(width) / diagram.get_display_w();
+    const double scale_y = static_cast<double>(height) / diagram.get_display_h();
+
+    if (style.fill_cells && !sites.empty())
+    {
+        const std::vector<cell> cells = diagram.build_cells();
+        std::vector<rgba> colors(cells.size());
+        for (std::size_t i = 0; i < cells.size(); i++)
+        {
+            colors[i] = cell_color(diagram.get_caller_id(i)); //the same colours whether the sites were reordered or not
+        }
+        fill_cells(image, cells, colors, scale_x, scale_y);
+    }
+    if (style.draw_edges)
+    {
+        draw_lines(image, diagram.get_diagram_edges(), style.edge_color, style.edge_width, scale_x, scale_y);
+    }
+    if (style.draw_sites)
+    {
+        const int tiles_x = (width + tile_size - 1) / tile_size;
+        const int tiles_y = (height + tile_size - 1) / tile_size;
+        std::vector<std::vector<std::uint32_t>> site_bins(static_cast<std::size_t>(tiles_x) * tiles_y);
+        for (std::uint32_t i = 0; i < sites.size(); i++)
+        {
+            const double x = sites[i].x * scale_x;
+            const double y = sites[i].y * scale_y;
+            bin_segment(site_bins, tiles_x, tiles_y, i, x, y, x, y, style.site_radius + 1.0);
+        }
+        parallel_for(0, site_bins.size(), [&](const std::size_t tile_index) {
+            const int tx = static_cast<int>(tile_index % tiles_x);
+            const int ty = static_cast<int>(tile_index / tiles_x);
+            const pixel_rect tile{tx * tile_size, ty * tile_size, std::min((tx + 1) * tile_size, width), std::min((ty + 1) * tile_size, height)};
+            for (const std::uint32_t i : site_bins[tile_index])
+            {
+                stamp(image, tile, static_cast<int>(sites[i].x * scale_x), static_cast<int>(sites[i].y * scale_y), style.site_radius, style.site_color);
+            }
+        });
+    }
+    return image;
+}
@@ -0,0 +1,55 @@
+#pragma once
+//headless software rendering of a finished voronoi_diagram into an in-memory RGBA image.
+//the image is split into square tiles which are drawn in parallel, every tile only looks at the sites and edges touching it.
+
+#include "voronoi.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct rgba {
+    std::uint8_t r;
+    std::uint8_t g;
+    std::uint8_t b;
+    std::uint8_t a;
+};
+
+struct raster_image {
+    int width;
+    int height;
+    std::vector<rgba> pixels; //row major, top row first
+
+    raster_image(int width, int height, rgba fill = {255, 255, 255, 255}); //0 x 0 when either side is not positive
+    rgba& at(const int x, const int y) {return pixels[static_cast<std::size_t>(y) * width + x];}
+    const rgba& at(const int x, const int y) const {return pixels[static_cast<std::size_t>(y) * width + x];}
+
+    bool write_ppm(const std::string& path) const; //binary P6, alpha is dropped
+    bool write_png(const std::string& path) const; //uncompressed (stored) deflate, no zlib needed
+    bool write(const std::string& path) const; //picks the format from the file extension, fails on an empty image
+};
+
+struct raster_style {
+    rgba background{255, 255, 255, 255};
+    rgba site_color{0, 0, 0, 255};
+    rgba edge_color{255, 0, 0, 255};
+    bool fill_cells = true; //colour every cell with cell_color
+    bool draw_edges = true;
+    bool draw_sites = true;
+    int edge_width = 1; //in output pixels
+    int site_radius = 1;
+};
+
+//stable colour for the cell of site number index
+rgba cell_color(std::size_t index);
+
+//scanline fill of every cell polygon with colors[i], the polygons are scaled by scale_x/scale_y to pixels.
+//each pixel is written once no matter how many cells there are.
+void fill_cells(raster_image& image, const std::vector<cell>& cells, const std::vector<rgba>& colors, double scale_x, double scale_y);
+
+//line segments drawn tile by tile in parallel, coordinates scaled by scale_x/scale_y to pixels
+void draw_lines(raster_image& image, const std::vector<edge>& lines, rgba color, int line_width, double scale_x, double scale_y);
+
+//the diagram (display_w x display_h) is scaled to fill width x height
+raster_image rasterize_diagram(const voronoi_diagram& diagram, int width, int height, const raster_style& style = raster_style());
@@ -0,0 +1,101 @@
+#pragma once
+//edge table scanline walk over a polygon, shared by everything that fills or integrates over cells.
+//a pixel belongs to the polygon when its centre is inside, so neighbouring cells never both claim a pixel.
+
+#include "utilities.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+struct scanline_edge {
+    double y_top;
+    double y_bottom;
+    double x_top;
+    double slope; //dx per row
+};
+
+//calls span(y, x0, x1) for every covered run of pixels x0 <= x < x1 on the rows row_begin <= y < row_end.
+//polygon coordinates are multiplied by scale_x/scale_y to get pixels.
+template<typename Fn>
+void for_each_span(const std::vector<point>& polygon, const double scale_x, const double scale_y, const int width,
+                   const int row_begin, const int row_end, const Fn& span)
+{
+    thread_local std::vector<scanline_edge> edge_table;
+    thread_local std::vector<int> active;
+    thread_local std::vector<double> crossings;
+    edge_table.clear();
+    active.clear();
+
+    double top = std::numeric_limits<double>::max();
+    double bottom = std::numeric_limits<double>::lowest();
+    for (std::size_t i = 0; i < polygon.size(); i++)
+    {
+        const point& a = polygon[i];
+        const point& b = polygon[(i + 1) % polygon.size()];
+        double ax = a.x * scale_x, ay = a.y * scale_y;
+        double bx = b.x * scale_x, by = b.y * scale_y;
+        if (ay == by)
+        {
+            continue; //horizontal edges never cross a row centre
+        }
+        if (ay > by)
+        {
+            std::swap(ax, bx);
+            std::swap(ay, by);
+        }
+        edge_table.push_back({ay, by, ax, (bx - ax) / (by - ay)});
+        top = std::min(top, ay);
+        bottom = std::max(bottom, by);
+    }
+    if (edge_table.empty())
+    {
+        return;
+    }
+    std::sort(edge_table.begin(), edge_table.end(), [](const scanline_edge& l, const scanline_edge& r) {return l.y_top < r.y_top;});
+
+    //rows whose centre y+0.5 lies in [top, bottom)
+    const int first_row = std::max(row_begin, static_cast<int>(std::ceil(top - 0.5)));
+    const int last_row = std::min(row_end, static_cast<int>(std::ceil(bottom - 0.5)));
+    std::size_t next_edge = 0;
+    for (int y = first_row; y < last_row; y++)
+    {
+        const double center = y + 0.5;
+        while (next_edge < edge_table.size() && edge_table[next_edge].y_top <= center)
+        {
+            active.push_back(static_cast<int>(next_edge++));
+        }
+        active.erase(std::remove_if(active.begin(), active.end(), [&](const int e) {return edge_table[e].y_bottom <= center;}), active.end());
+
+        crossings.clear();
+        for (const int e : active)
+        {
+            crossings.push_back(edge_table[e].x_top + (center - edge_table[e].y_top) * edge_table[e].slope);
+        }
+        std::sort(crossings.begin(), crossings.end());
+        for (std::size_t k = 0; k + 1 < crossings.size(); k += 2)
+        {
+            const int x0 = std::max(0, static_cast<int>(std::ceil(crossings[k] - 0.5)));
+            const int x1 = std::min(width, static_cast<int>(std::ceil(crossings[k + 1] - 0.5)));
+            if (x0 < x1)
+            {
+                span(y, x0, x1);
+            }
+        }
+    }
+}
+
+//pixel rows [first, last) a polygon can touch at this scale
+inline void polygon_rows(const std::vector<point>& polygon, const double scale_y, int& first, int& last)
+{
+    double top = std::numeric_limits<double>::max();
+    double bottom = std::numeric_limits<double>::lowest();
+    for (const point& p : polygon)
+    {
+        top = std::min(top, p.y * scale_y);
+        bottom = std::max(bottom, p.y * scale_y);
+    }
+    first = polygon.empty() ? 0 : static_cast<int>(std::ceil(top - 0.5));
+    last = polygon.empty() ? 0 : static_cast<int>(std::ceil(bottom - 0.5));
+}
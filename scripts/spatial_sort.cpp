@@ -0,0 +1,61 @@
+#include "spatial_sort.h"
+#include "parallel.h"
+#include "radix_sort.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+std::uint32_t hilbert_index(const std::uint32_t x, const std::uint32_t y)
+{
+    //two bits of the index per level, highest first. each quadrant the curve goes into can be mirrored (swap x and y)
+    //and turned around (flip every bit), which is carried along as two flags instead of changing x and y. all of it is
+    //done with xor so there are no branches to mispredict on the random bits
+    std::uint32_t index = 0;
+    std::uint32_t swap = 0;
+    std::uint32_t flip = 0;
+    for (int level = 15; level >= 0; level--)
+    {
+        const std::uint32_t bit_x = ((x >> level) & 1) ^ flip;
+        const std::uint32_t bit_y = ((y >> level) & 1) ^ flip;
+        const std::uint32_t swapped = (bit_x ^ bit_y) & swap;
+        const std::uint32_t rx = bit_x ^ swapped;
+        const std::uint32_t ry = bit_y ^ swapped;
+        index = (index << 2) | ((3 * rx) ^ ry);
+        const std::uint32_t turn = ry ^ 1;
+        swap ^= turn;
+        flip ^= turn & rx;
+    }
+    return index;
+}
+
+std::vector<int> hilbert_order(const std::vector<point>& sites)
+{
+    double min_x = std::numeric_limits<double>::infinity(), min_y = min_x;
+    double max_x = -min_x, max_y = -min_x;
+    for (const point& site : sites)
+    {
+        min_x = std::min(min_x, site.x);
+        max_x = std::max(max_x, site.x);
+        min_y = std::min(min_y, site.y);
+        max_y = std::max(max_y, site.y);
+    }
+    //a square, so the curve is not stretched along the longer side
+    const double extent = std::max(max_x - min_x, max_y - min_y);
+    const double scale = extent > 0.0 ? 65535.0 / extent : 0.0;
+
+    std::vector<std::pair<std::uint32_t, int>> keyed(sites.size());
+    parallel_for(0, sites.size(), [&](const std::size_t i) {
+        const auto x = static_cast<std::uint32_t>((sites[i].x - min_x) * scale);
+        const auto y = static_cast<std::uint32_t>((sites[i].y - min_y) * scale);
+        keyed[i] = {hilbert_index(x, y), static_cast<int>(i)};
+    }, 1 << 14);
+    radix_sort(keyed, [](const std::pair<std::uint32_t, int>& item) {return item.first;}, 32);
+
+    std::vector<int> order(sites.size());
+    for (std::size_t i = 0; i < keyed.size(); i++)
+    {
+        order[i] = keyed[i].second;
+    }
+    return order;
+}
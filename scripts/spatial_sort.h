@@ -0,0 +1,14 @@
+#pragma once
+//orders sites along a hilbert curve, so sites that are close in the plane are also close in memory. arrays indexed by
+//site (cells, labels, kd-tree leaves) are then walked in spatial order instead of in whatever order the caller had.
+
+#include "utilities.h"
+
+#include <cstdint>
+#include <vector>
+
+//position of grid cell (x, y) of a 65536 x 65536 grid along the hilbert curve through it
+std::uint32_t hilbert_index(std::uint32_t x, std::uint32_t y);
+
+//order[i] is the index in sites of the i-th site along the curve. the curve is laid over the bounding square of the sites
+std::vector<int> hilbert_order(const std::vector<point>& sites);
@@ -0,0 +1,159 @@
+#include "stipple.h"
+#include "cell_engine.h"
+#include "parallel.h"
+#include "scanline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+density_table::density_table(const raster_image& source, const double gamma)
+    : width(source.width), height(source.height),
+      mass(static_cast<std::size_t>(source.height) * (source.width + 1)),
+      moment(static_cast<std::size_t>(source.height) * (source.width + 1))
+{
+    parallel_for(0, static_cast<std::size_t>(height), [&](const std::size_t y) {
+        double* row_mass = &mass[y * (width + 1)];
+        double* row_moment = &moment[y * (width + 1)];
+        row_mass[0] = 0;
+        row_moment[0] = 0;
+        for (int x = 0; x < width; x++)
+        {
+            const rgba& c = source.at(x, static_cast<int>(y));
+            const double luminance = (0.299 * c.r + 0.587 * c.g + 0.114 * c.b) / 255.0;
+            const double density = std::pow(std::max(0.0, 1.0 - luminance), gamma);
+            row_mass[x + 1] = row_mass[x] + density;
+            row_moment[x + 1] = row_moment[x] + density * (x + 0.5);
+        }
+    }, 16);
+}
+
+void density_table::accumulate(const int y, const int x0, const int x1, double& total, double& sum_x, double& sum_y) const
+{
+    const std::size_t row = static_cast<std::size_t>(y) * (width + 1);
+    const double span_mass = mass[row + x1] - mass[row + x0];
+    total += span_mass;
+    sum_x += moment[row + x1] - moment[row + x0];
+    sum_y += span_mass * (y + 0.5);
+}
+
+namespace {
+    //initial dots drawn from the density itself, a row by its total then a pixel inside it
+    std::vector<point> sample_density(const density_table& table, const int count, std::mt19937& gen)
+    {
+        std::vector<double> rows(static_cast<std::size_t>(table.height));
+        double total = 0;
+        for (int y = 0; y < table.height; y++)
+        {
+            total += table.row_mass(y);
+            rows[y] = total;
+        }
+
+        std::uniform_real_distribution<> unit(0.0, 1.0);
+        std::vector<point> dots;
+        dots.reserve(static_cast<std::size_t>(count));
+        for (int i = 0; i < count; i++)
+        {
+            if (total <= 0) //blank image, nothing to follow
+            {
+                dots.emplace_back(unit(gen) * table.width, unit(gen) * table.height);
+                continue;
+            }
+            const int y = std::min(static_cast<int>(std::upper_bound(rows.begin(), rows.end(), unit(gen) * total) - rows.begin()), table.height - 1);
+            const auto row_begin = table.mass.begin() + static_cast<std::ptrdiff_t>(y) * (table.width + 1);
+            const double target = unit(gen) * table.row_mass(y);
+            const int x = std::min(std::max(static_cast<int>(std::upper_bound(row_begin, row_begin + table.width + 1, target) - row_begin) - 1, 0), table.width - 1);
+            dots.emplace_back(x + unit(gen), y + unit(gen));
+        }
+        return dots;
+    }
+}
+
+std::vector<point> weighted_stipple(const raster_image& source, const stipple_options& options)
+{
+    if (source.width <= 0 || source.height <= 0 || options.dots <= 0)
+    {
+        return {};
+    }
+    const density_table table(source, options.gamma);
+    std::mt19937 gen(options.seed);
+    std::vector<point> dots = sample_density(table, options.dots, gen);
+
+    //reused by every iteration
+    std::vector<point> centroids(dots);
+    std::vector<double> displacement(dots.size());
+    std::vector<cell> cells;
+    const double max_x = std::nextafter(static_cast<double>(source.width), 0.0);
+    const double max_y = std::nextafter(static_cast<double>(source.height), 0.0);
+
+    for (int iteration = 0; iteration < options.iterations; iteration++)
+    {
+        //the cells straight from the kd-tree engine, there is no use for the edges of a sweep here
+        compute_cells(dots, source.width, source.height, cells);
+
+        parallel_for(0, cells.size(), [&](const std::size_t i) {
+            double total = 0, sum_x = 0, sum_y = 0;
+            for_each_span(cells[i].polygon, 1.0, 1.0, source.width, 0, source.height, [&](const int y, const int x0, const int x1) {
+                table.accumulate(y, x0, x1, total, sum_x, sum_y);
+            });
+            //a cell over blank paper has nothing to pull it, it stays put
+            centroids[i] = total > 1e-12 ? point(std::min(std::max(sum_x / total, 0.0), max_x), std::min(std::max(sum_y / total, 0.0), max_y)) : dots[i];
+            displacement[i] = std::hypot(centroids[i].x - dots[i].x, centroids[i].y - dots[i].y);
+        }, 64);
+
+        dots.swap(centroids);
+        if (*std::max_element(displacement.begin(), displacement.end()) < options.stop_displacement)
+        {
+            break;
+        }
+    }
+    return dots;
+}
+
+raster_image render_stipple(const std::vector<point>& dots, const int width, const int height, const stipple_options& options)
+{
+    raster_image image(width, height, options.background);
+    const double radius = std::max(options.dot_radius, 0.5);
+
+    //dots binned into horizontal bands which are drawn in parallel
+    constexpr int band_height = 32;
+    const int bands = (height + band_height - 1) / band_height;
+    std::vector<std::vector<std::uint32_t>> band_dots(static_cast<std::size_t>(std::max(bands, 0)));
+    for (std::uint32_t i = 0; i < dots.size(); i++)
+    {
+        const double y = dots[i].y * options.scale;
+        const int first = std::max(static_cast<int>(std::floor(y - radius)), 0);
+        const int last = std::min(static_cast<int>(std::ceil(y + radius)), height - 1);
+        for (int band = first / band_height; first <= last && band <= last / band_height; band++)
+        {
+            band_dots[band].push_back(i);
+        }
+    }
+
+    parallel_for(0, band_dots.size(), [&](const std::size_t band) {
+        const int row_begin = static_cast<int>(band) * band_height;
+        const int row_end = std::min(row_begin + band_height, height);
+        for (const std::uint32_t i : band_dots[band])
+        {
+            const double cx = dots[i].x * options.scale;
+            const double cy = dots[i].y * options.scale;
+            //pixel centres inside the disc
+            const int y0 = std::max(static_cast<int>(std::ceil(cy - radius - 0.5)), row_begin);
+            const int y1 = std::min(static_cast<int>(std::floor(cy + radius - 0.5)), row_end - 1);
+            for (int y = y0; y <= y1; y++)
+            {
+                const double dy = y + 0.5 - cy;
+                const double half = std::sqrt(std::max(radius * radius - dy * dy, 0.0));
+                const int x0 = std::max(static_cast<int>(std::ceil(cx - half - 0.5)), 0);
+                const int x1 = std::min(static_cast<int>(std::floor(cx + half - 0.5)), width - 1);
+                for (int x = x0; x <= x1; x++)
+                {
+                    image.at(x, y) = options.dot_color;
+                }
+            }
+        }
+    });
+    return image;
+}
@@ -0,0 +1,37 @@
+#pragma once
+//weighted voronoi stippling: dots are moved to the density weighted centroids of their cells, dark areas end up with more dots.
+//the density is turned into per row prefix sums once, after that a cell centroid is two lookups per scanline of the cell.
+
+#include "raster.h"
+
+#include <vector>
+
+struct stipple_options {
+    int dots = 4000;
+    int iterations = 30;
+    double gamma = 1.0; //density = (1 - luminance)^gamma, above 1 pushes dots into the darkest parts
+    double stop_displacement = 0.05; //stop early once no dot moves further than this (pixels)
+    double dot_radius = 1.0; //in output pixels
+    double scale = 1.0; //output image size relative to the source
+    rgba dot_color{0, 0, 0, 255};
+    rgba background{255, 255, 255, 255};
+    unsigned seed = 1;
+};
+
+//prefix sums of density and x * density for every row, width + 1 entries per row with a leading 0
+struct density_table {
+    int width;
+    int height;
+    std::vector<double> mass;
+    std::vector<double> moment;
+
+    density_table(const raster_image& source, double gamma);
+    double row_mass(const int y) const {return mass[static_cast<std::size_t>(y) * (width + 1) + width];}
+    //adds the pixels [x0, x1) of row y
+    void accumulate(int y, int x0, int x1, double& total, double& sum_x, double& sum_y) const;
+};
+
+//dot positions in source pixel coordinates
+std::vector<point> weighted_stipple(const raster_image& source, const stipple_options& options = stipple_options());
+
+raster_image render_stipple(const std::vector<point>& dots, int width, int height, const stipple_options& options = stipple_options());
@@ -0,0 +1,73 @@
+#include "sweep_stepper.h"
+
+bool sweep_stepper::next(sweep_record& record)
+{
+    while (next_pending == pending.size())
+    {
+        if (!advance())
+        {
+            return false;
+        }
+    }
+    record = pending[next_pending++];
+    return true;
+}
+
+//runs the next event, or finishes the open edges after the last one
+bool sweep_stepper::advance()
+{
+    pending.clear();
+    next_pending = 0;
+    const std::size_t edges_before = diagram.diagram_edges.size();
+    const std::size_t vertices_before = diagram.vertices.size();
+    if (diagram.events_left())
+    {
+        diagram.run_next_event();
+        const site_event& event = diagram.current_event;
+        sweep_record record;
+        record.sweepline_y = diagram.sweepline.y;
+        record.position = event.getSite();
+        record.end = event.getSite();
+        if (event.getIsCircleEvent())
+        {
+            record.kind = sweep_record_kind::circle;
+            record.end = event.getCirclePoints(1);
+            record.arc_sites = {event.getCirclePoints(0), event.getCirclePoints(2)};
+        }
+        pending.push_back(record);
+        add_new(edges_before, vertices_before, record.sweepline_y);
+        return true;
+    }
+    if (!completed)
+    {
+        completed = true;
+        diagram.complete_edges();
+        add_new(edges_before, vertices_before, diagram.sweepline.y);
+        return true;
+    }
+    return false;
+}
+
+void sweep_stepper::add_new(const std::size_t edges_before, const std::size_t vertices_before, const double sweepline_y)
+{
+    for (std::size_t i = vertices_before; i < diagram.vertices.size(); i++)
+    {
+        sweep_record record;
+        record.kind = sweep_record_kind::vertex;
+        record.sweepline_y = sweepline_y;
+        record.position = diagram.vertices[i];
+        record.end = diagram.vertices[i];
+        pending.push_back(record);
+    }
+    for (std::size_t i = edges_before; i < diagram.diagram_edges.size(); i++)
+    {
+        const edge& closed = diagram.diagram_edges[i];
+        sweep_record record;
+        record.kind = sweep_record_kind::edge_closed;
+        record.sweepline_y = sweepline_y;
+        record.position = closed.start;
+        record.end = closed.end;
+        record.arc_sites = closed.arc_sites;
+        pending.push_back(record);
+    }
+}
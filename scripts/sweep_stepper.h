@@ -0,0 +1,72 @@
+#pragma once
+//pulls the sweep of a voronoi_diagram one record at a time: the event itself, then the vertices and finished edges it
+//made. nothing runs until a record is asked for, so a viewer or tracer can take as many steps as it wants and stop.
+//edges and vertices are only ever appended by the diagram, the stepper hands out what is new after each event.
+//only for the sweep engine
+//
+//    sweep_stepper stepper(diagram);
+//    for (const sweep_record& record : stepper) { ... }
+
+#include "voronoi.h"
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+enum class sweep_record_kind {
+    site,       //the sweepline reached a site
+    circle,     //an arc disappeared
+    vertex,     //a vertex of the diagram was found
+    edge_closed //an edge of the diagram is finished
+};
+
+struct sweep_record {
+    sweep_record_kind kind = sweep_record_kind::site;
+    double sweepline_y = 0.0;
+    point position{0, 0}; //site: the site. circle and vertex: the vertex. edge_closed: where the edge starts
+    point end{0, 0};      //edge_closed: where the edge ends. circle: the site whose arc disappeared
+    std::pair<point, point> arc_sites{point(0, 0), point(0, 0)}; //edge_closed: the sites on either side. circle: the arcs left and right of it
+};
+
+class sweep_stepper {
+    private:
+        voronoi_diagram& diagram;
+        std::vector<sweep_record> pending; //records of the last event not handed out yet, the buffer is reused
+        std::size_t next_pending = 0;
+        bool completed = false; //the open edges have been finished after the last event
+
+        bool advance();
+        void add_new(std::size_t edges_before, std::size_t vertices_before, double sweepline_y);
+    public:
+        explicit sweep_stepper(voronoi_diagram& diagram) : diagram(diagram) {}
+        bool next(sweep_record& record); //false once the sweep is over
+
+        class iterator {
+            private:
+                sweep_stepper* stepper; //null at the end
+                sweep_record record;
+            public:
+                using iterator_category = std::input_iterator_tag;
+                using value_type = sweep_record;
+                using difference_type = std::ptrdiff_t;
+                using pointer = const sweep_record*;
+                using reference = const sweep_record&;
+
+                explicit iterator(sweep_stepper* stepper) : stepper(stepper) {++*this;}
+                const sweep_record& operator*() const {return record;}
+                const sweep_record* operator->() const {return &record;}
+                iterator& operator++()
+                {
+                    if (stepper != nullptr && !stepper->next(record))
+                    {
+                        stepper = nullptr;
+                    }
+                    return *this;
+                }
+                bool operator==(const iterator& other) const {return stepper == other.stepper;}
+                bool operator!=(const iterator& other) const {return stepper != other.stepper;}
+        };
+        iterator begin() {return iterator(this);}
+        iterator end() {return iterator(nullptr);}
+};
@@ -0,0 +1,72 @@
+#include "sweep_telemetry.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    //later counters, higher peaks, the y of the first
+    void merge_into(telemetry_sample& into, const telemetry_sample& later)
+    {
+        into.events = later.events;
+        into.arcs = std::max(into.arcs, later.arcs);
+        into.queued_events = std::max(into.queued_events, later.queued_events);
+        into.circle_events = later.circle_events;
+        into.cancelled_events = later.cancelled_events;
+        into.edges = later.edges;
+    }
+}
+
+sweep_telemetry::sweep_telemetry(const std::size_t max_samples) : max_samples(std::max<std::size_t>(max_samples, 2))
+{
+    samples.reserve(this->max_samples + 1);
+}
+
+void sweep_telemetry::record(const telemetry_sample& now)
+{
+    if (!samples.empty() && now.sweepline_y - samples.back().sweepline_y < spacing)
+    {
+        merge_into(samples.back(), now);
+        return;
+    }
+    samples.push_back(now);
+    if (samples.size() > max_samples)
+    {
+        //every two neighbours become one, and from now on samples are as far apart as those are on average
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < samples.size(); i += 2, kept++)
+        {
+            samples[kept] = samples[i];
+            if (i + 1 < samples.size())
+            {
+                merge_into(samples[kept], samples[i + 1]);
+            }
+        }
+        samples.resize(kept);
+        spacing = std::max(spacing * 2, (samples.back().sweepline_y - samples.front().sweepline_y) / static_cast<double>(kept));
+    }
+}
+
+void sweep_telemetry::clear()
+{
+    samples.clear();
+    spacing = 0.0;
+}
+
+bool sweep_telemetry::write_csv(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "Could not open " << path << " for the telemetry" << std::endl;
+        return false;
+    }
+    file << "sweepline_y,events,arcs,queued_events,circle_events,cancelled_events,false_alarm_rate,edges\n";
+    for (const telemetry_sample& sample : samples)
+    {
+        const double false_alarms = sample.circle_events == 0 ? 0.0 : static_cast<double>(sample.cancelled_events) / static_cast<double>(sample.circle_events);
+        file << sample.sweepline_y << ',' << sample.events << ',' << sample.arcs << ',' << sample.queued_events << ','
+             << sample.circle_events << ',' << sample.cancelled_events << ',' << false_alarms << ',' << sample.edges << '\n';
+    }
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,33 @@
+#pragma once
+//how the sweep's state grows and shrinks over a run, indexed by sweepline y. voronoi_diagram::set_telemetry hands it
+//one and the sweep adds a sample after every event. neighbouring samples are merged once there are more than
+//max_samples, keeping the peaks, so a run of any length ends up as a few hundred rows. write_csv exports them and
+//display_full draws them as a graph next to the sweep (key t).
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct telemetry_sample {
+    double sweepline_y = 0.0;             //where the sample (or the first of the merged ones) was taken
+    std::uint64_t events = 0;             //events run so far
+    std::size_t arcs = 0;                 //arcs on the beachline, the highest of the merged samples
+    std::size_t queued_events = 0;        //circle events waiting, and weighted sites, the highest of the merged samples
+    std::uint64_t circle_events = 0;      //circle events added so far
+    std::uint64_t cancelled_events = 0;   //of those, removed again before the sweep got to them (false alarms)
+    std::size_t edges = 0;                //finished edges so far
+};
+
+class sweep_telemetry {
+    private:
+        std::vector<telemetry_sample> samples;
+        std::size_t max_samples;
+        double spacing = 0.0; //samples closer than this in y are merged
+    public:
+        explicit sweep_telemetry(std::size_t max_samples = 512);
+        void record(const telemetry_sample& now);
+        void clear();
+        const std::vector<telemetry_sample>& get_samples() const {return samples;}
+        bool write_csv(const std::string& path) const;
+};
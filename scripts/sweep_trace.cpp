@@ -0,0 +1,179 @@
+#include "sweep_trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+    std::int64_t clock_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::atomic<std::uint64_t> next_tracer_id{1};
+}
+
+sweep_tracer::ring::ring(const std::size_t capacity, const std::thread::id owner, const unsigned id) : owner(owner), id(id)
+{
+    std::size_t size = 1;
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+    spans.resize(size);
+    mask = size - 1;
+}
+
+sweep_tracer::sweep_tracer(const trace_options& options) : options(options), tracer_id(next_tracer_id++), start_ns(clock_ns())
+{
+    this->options.sample_every = std::max<std::uint64_t>(this->options.sample_every, 1);
+}
+
+std::uint64_t sweep_tracer::now_ns() const
+{
+    return static_cast<std::uint64_t>(clock_ns() - start_ns);
+}
+
+sweep_tracer::ring& sweep_tracer::thread_ring()
+{
+    thread_local std::uint64_t cached_tracer = 0;
+    thread_local ring* cached = nullptr;
+    if (cached_tracer != tracer_id)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        const std::thread::id self = std::this_thread::get_id();
+        const auto found = std::find_if(rings.begin(), rings.end(), [&](const std::unique_ptr<ring>& r) {return r->owner == self;});
+        if (found == rings.end())
+        {
+            rings.emplace_back(new ring(options.ring_capacity, self, static_cast<unsigned>(rings.size())));
+            cached = rings.back().get();
+        }
+        else
+        {
+            cached = found->get();
+        }
+        cached_tracer = tracer_id;
+    }
+    return *cached;
+}
+
+sweep_tracer::ring* sweep_tracer::begin_span(const trace_phase phase, std::uint64_t& start)
+{
+    ring& own = thread_ring();
+    std::atomic<std::uint64_t>& calls = own.calls[static_cast<std::size_t>(phase)];
+    calls.store(calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (phase == trace_phase::event)
+    {
+        own.sampling = own.events++ % options.sample_every == 0;
+    }
+    //a run and its end are rare, they are always timed
+    if (!own.sampling && phase != trace_phase::run && phase != trace_phase::complete_edges)
+    {
+        return nullptr;
+    }
+    start = now_ns();
+    return &own;
+}
+
+void sweep_tracer::end_span(ring& target, const trace_phase phase, const std::uint64_t start)
+{
+    const std::uint64_t end = now_ns();
+    //the last few slots are kept for the spans that are always timed, they end last and would never fit otherwise
+    constexpr std::size_t kept_slots = 16;
+    const bool always = phase == trace_phase::run || phase == trace_phase::complete_edges;
+    const std::size_t capacity = target.mask + 1;
+    const std::size_t head = target.head.load(std::memory_order_relaxed);
+    if (head - target.tail.load(std::memory_order_acquire) >= (always || capacity <= kept_slots ? capacity : capacity - kept_slots))
+    {
+        target.dropped.store(target.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    target.spans[head & target.mask] = {start, end - start, phase};
+    target.head.store(head + 1, std::memory_order_release);
+}
+
+void sweep_tracer::drain()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (const std::unique_ptr<ring>& r : rings)
+    {
+        const std::size_t head = r->head.load(std::memory_order_acquire);
+        std::size_t tail = r->tail.load(std::memory_order_relaxed);
+        for (; tail != head; tail++)
+        {
+            drained.push_back({r->id, r->spans[tail & r->mask]});
+        }
+        r->tail.store(tail, std::memory_order_release);
+    }
+}
+
+bool sweep_tracer::write_json(const std::string& path)
+{
+    drain();
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "Could not open " << path << " for the trace" << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const std::unique_ptr<ring>& r : rings)
+    {
+        file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << r->id << ",\"args\":{\"name\":\"sweep " << r->id << "\"}}";
+        first = false;
+    }
+    //chrome wants microseconds, three decimals keep the nanoseconds
+    file << std::fixed << std::setprecision(3);
+    std::array<std::uint64_t, phase_count> sampled{};
+    std::array<std::uint64_t, phase_count> sampled_ns{};
+    for (const drained_span& d : drained)
+    {
+        const std::size_t phase = static_cast<std::size_t>(d.recorded.phase);
+        sampled[phase]++;
+        sampled_ns[phase] += d.recorded.duration_ns;
+        file << (first ? "" : ",") << "\n{\"name\":\"" << phase_name(d.recorded.phase) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << d.thread
+             << ",\"ts\":" << d.recorded.start_ns / 1000.0 << ",\"dur\":" << d.recorded.duration_ns / 1000.0 << "}";
+        first = false;
+    }
+    //the totals: every call counted, the time estimated from the timed ones
+    std::uint64_t dropped = 0;
+    std::array<std::uint64_t, phase_count> calls{};
+    for (const std::unique_ptr<ring>& r : rings)
+    {
+        dropped += r->dropped.load(std::memory_order_relaxed);
+        for (std::size_t phase = 0; phase < phase_count; phase++)
+        {
+            calls[phase] += r->calls[phase].load(std::memory_order_relaxed);
+        }
+    }
+    file << "\n],\"otherData\":{\"sample_every\":\"" << options.sample_every << "\",\"dropped_spans\":\"" << dropped << "\"";
+    for (std::size_t phase = 0; phase < phase_count; phase++)
+    {
+        const double mean_us = sampled[phase] == 0 ? 0.0 : static_cast<double>(sampled_ns[phase]) / static_cast<double>(sampled[phase]) / 1000.0;
+        file << ",\"" << phase_name(static_cast<trace_phase>(phase)) << "\":\"calls " << calls[phase] << ", timed " << sampled[phase]
+             << ", mean " << mean_us << " us, estimated total " << mean_us * static_cast<double>(calls[phase]) / 1000.0 << " ms\"";
+    }
+    file << "}}\n";
+    return static_cast<bool>(file);
+}
+
+const char* sweep_tracer::phase_name(const trace_phase phase)
+{
+    switch (phase)
+    {
+        case trace_phase::run: return "run_voronoi";
+        case trace_phase::event: return "event";
+        case trace_phase::next_site: return "next_site";
+        case trace_phase::update_beachline: return "update_beachline";
+        case trace_phase::update_breakpoints: return "update_breakpoints";
+        case trace_phase::add_circle_event: return "add_circle_event";
+        case trace_phase::remove_circle_event: return "remove_circle_event";
+        case trace_phase::half_edges: return "half_edges";
+        case trace_phase::complete_edges: return "complete_edges";
+        default: return "unknown";
+    }
+}
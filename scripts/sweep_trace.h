@@ -0,0 +1,115 @@
+#pragma once
+//optional tracer for the sweep. voronoi_diagram::set_tracer hands it one and the sweep then puts scoped spans around
+//its phases. every thread writes into a ring of its own which only it pushes to, so recording never takes a lock.
+//write_json turns it all into a chrome trace_event file (chrome://tracing or ui.perfetto.dev).
+//with sample_every n only every nth event and what runs inside it is timed, the rest is only counted. the counts and
+//the mean times of the sampled spans are written too, so a run of millions of events still gives the full picture.
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class trace_phase : std::uint8_t {
+    run,                 //run_voronoi
+    event,               //run_next_event
+    next_site,
+    update_beachline,
+    update_breakpoints,
+    add_circle_event,
+    remove_circle_event,
+    half_edges,          //edges started and finished at a vertex
+    complete_edges,
+    count
+};
+
+struct trace_options {
+    std::uint64_t sample_every = 1;       //time every nth event
+    std::size_t ring_capacity = 1 << 16;  //spans a thread keeps until drain, later ones are dropped and counted
+};
+
+class sweep_tracer {
+    public:
+        static constexpr std::size_t phase_count = static_cast<std::size_t>(trace_phase::count);
+
+        struct span {
+            std::uint64_t start_ns; //since the tracer was made
+            std::uint64_t duration_ns;
+            trace_phase phase;
+        };
+        //single producer single consumer ring of one thread. the counters are only written by that thread
+        struct ring {
+            std::vector<span> spans;
+            std::size_t mask;
+            std::atomic<std::size_t> head{0}; //next slot to write, moved by the thread
+            std::atomic<std::size_t> tail{0}; //next slot to read, moved by drain
+            std::array<std::atomic<std::uint64_t>, phase_count> calls{}; //every span, timed or not
+            std::atomic<std::uint64_t> dropped{0};
+            std::uint64_t events = 0;
+            bool sampling = true; //the current event is timed
+            std::thread::id owner;
+            unsigned id;
+
+            ring(std::size_t capacity, std::thread::id owner, unsigned id);
+        };
+    private:
+        trace_options options;
+        std::uint64_t tracer_id; //tells tracers apart in the per thread cache, addresses can be reused
+        std::int64_t start_ns;
+
+        std::mutex lock; //registering rings and draining them
+        std::vector<std::unique_ptr<ring>> rings;
+        struct drained_span {
+            unsigned thread;
+            span recorded;
+        };
+        std::vector<drained_span> drained;
+
+        ring& thread_ring();
+    public:
+        explicit sweep_tracer(const trace_options& options = trace_options());
+        sweep_tracer(const sweep_tracer&) = delete;
+        sweep_tracer& operator=(const sweep_tracer&) = delete;
+
+        //the ring the span goes into, null when it is not timed
+        ring* begin_span(trace_phase phase, std::uint64_t& start);
+        void end_span(ring& target, trace_phase phase, std::uint64_t start);
+        std::uint64_t now_ns() const;
+
+        void drain(); //moves what the rings hold so far out of them, can run while threads are still tracing
+        //everything drained so far and the per phase counts. once the traced runs are done, or the counts are a little behind
+        bool write_json(const std::string& path);
+
+        static const char* phase_name(trace_phase phase);
+};
+
+//times the scope it lives in, does nothing without a tracer
+class trace_scope {
+    private:
+        sweep_tracer* tracer;
+        sweep_tracer::ring* target = nullptr;
+        trace_phase phase;
+        std::uint64_t start = 0;
+    public:
+        trace_scope(sweep_tracer* tracer, const trace_phase phase) : tracer(tracer), phase(phase)
+        {
+            if (tracer != nullptr)
+            {
+                target = tracer->begin_span(phase, start);
+            }
+        }
+        ~trace_scope()
+        {
+            if (target != nullptr)
+            {
+                tracer->end_span(*target, phase, start);
+            }
+        }
+        trace_scope(const trace_scope&) = delete;
+        trace_scope& operator=(const trace_scope&) = delete;
+};
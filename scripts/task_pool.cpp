@@ -0,0 +1,133 @@
+#include "task_pool.h"
+
+#include <algorithm>
+
+task_pool::task_pool(const unsigned worker_threads) : workers(std::max(worker_threads, 1u))
+{
+    shares.reset(new share[workers]);
+    threads.reserve(workers - 1);
+    for (unsigned worker = 1; worker < workers; worker++)
+    {
+        threads.emplace_back(&task_pool::thread_loop, this, worker);
+    }
+}
+
+task_pool::~task_pool()
+{
+    {
+        std::lock_guard<std::mutex> guard(state_lock);
+        stopping = true;
+    }
+    start.notify_all();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+task_pool& task_pool::shared()
+{
+    static task_pool pool;
+    return pool;
+}
+
+void task_pool::run(const std::size_t count, const std::function<void(std::size_t, unsigned)>& job)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> one_run(run_lock);
+    for (unsigned worker = 0; worker < workers; worker++)
+    {
+        std::lock_guard<std::mutex> guard(shares[worker].lock);
+        shares[worker].begin = count * worker / workers;
+        shares[worker].end = count * (worker + 1) / workers;
+    }
+    {
+        std::lock_guard<std::mutex> guard(state_lock);
+        this->job = &job;
+        running = workers - 1;
+        generation++;
+    }
+    start.notify_all();
+    work(0);
+    std::unique_lock<std::mutex> guard(state_lock);
+    finished.wait(guard, [&]() {return running == 0;});
+    this->job = nullptr;
+}
+
+void task_pool::thread_loop(const unsigned worker)
+{
+    unsigned seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> guard(state_lock);
+            start.wait(guard, [&]() {return stopping || generation != seen;});
+            if (stopping)
+            {
+                return;
+            }
+            seen = generation;
+        }
+        work(worker);
+        bool last;
+        {
+            std::lock_guard<std::mutex> guard(state_lock);
+            last = --running == 0;
+        }
+        if (last)
+        {
+            finished.notify_one();
+        }
+    }
+}
+
+void task_pool::work(const unsigned worker)
+{
+    std::size_t index;
+    in_pool_job() = true;
+    while (take(worker, index))
+    {
+        (*job)(index, worker);
+    }
+    in_pool_job() = false;
+}
+
+//the next index from the worker's own share, or else from the back half of someone else's
+bool task_pool::take(const unsigned worker, std::size_t& index)
+{
+    {
+        share& own = shares[worker];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (own.begin < own.end)
+        {
+            index = own.begin++;
+            return true;
+        }
+    }
+    for (unsigned step = 1; step < workers; step++)
+    {
+        share& victim = shares[(worker + step) % workers];
+        std::size_t begin, end;
+        {
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (victim.begin >= victim.end)
+            {
+                continue;
+            }
+            end = victim.end;
+            begin = victim.begin + (victim.end - victim.begin) / 2;
+            victim.end = begin;
+        }
+        //the victim keeps the front half, which it is working through. of a single index the thief takes all of it
+        index = begin;
+        share& own = shares[worker];
+        std::lock_guard<std::mutex> guard(own.lock);
+        own.begin = begin + 1;
+        own.end = end;
+        return true;
+    }
+    return false;
+}
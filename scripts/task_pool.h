@@ -0,0 +1,52 @@
+#pragma once
+//worker threads that stay alive between runs, for work made of many small jobs. every run gives each worker an equal
+//share of the job indices, a worker that is through its share steals half of what another one has left. the workers
+//do not all count on one shared index, and jobs of very different lengths still keep every core busy to the end.
+
+#include "parallel.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class task_pool {
+    private:
+        struct share { //the indices a worker has left, [begin, end)
+            std::mutex lock;
+            std::size_t begin = 0;
+            std::size_t end = 0;
+        };
+
+        std::vector<std::thread> threads;
+        std::unique_ptr<share[]> shares; //one per worker, the caller of run is worker 0
+        unsigned workers;
+
+        std::mutex run_lock; //one run at a time
+        std::mutex state_lock;
+        std::condition_variable start;
+        std::condition_variable finished;
+        const std::function<void(std::size_t, unsigned)>* job = nullptr;
+        unsigned generation = 0; //counts runs, a change wakes the threads
+        unsigned running = 0;    //threads still working on this run
+        bool stopping = false;
+
+        void thread_loop(unsigned worker);
+        void work(unsigned worker);
+        bool take(unsigned worker, std::size_t& index);
+    public:
+        explicit task_pool(unsigned worker_threads = worker_count());
+        ~task_pool();
+        task_pool(const task_pool&) = delete;
+        task_pool& operator=(const task_pool&) = delete;
+
+        unsigned size() const {return workers;}
+        //calls job(index, worker) for every index in [0, count) with worker in [0, size()), returns when all are done.
+        //a worker runs one job at a time, so per worker scratch can be indexed by it. must not be called from a job
+        void run(std::size_t count, const std::function<void(std::size_t, unsigned)>& job);
+
+        static task_pool& shared(); //one pool with a worker per core, started on first use
+};
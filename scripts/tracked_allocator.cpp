@@ -0,0 +1,85 @@
+#include "tracked_allocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+
+namespace {
+    constexpr std::size_t tag_count = static_cast<std::size_t>(memory_tag::count);
+
+    struct alignas(64) tag_counters { //a cache line each, threads counting different tags do not get in each other's way
+        std::atomic<std::int64_t> live{0};
+        std::atomic<std::int64_t> peak{0};
+        std::atomic<std::uint64_t> allocations{0};
+        std::atomic<std::uint64_t> frees{0};
+    };
+
+    tag_counters counters[tag_count];
+}
+
+void record_allocation(const memory_tag tag, const std::size_t bytes)
+{
+    tag_counters& c = counters[static_cast<std::size_t>(tag)];
+    c.allocations.fetch_add(1, std::memory_order_relaxed);
+    const std::int64_t live = c.live.fetch_add(static_cast<std::int64_t>(bytes), std::memory_order_relaxed) + static_cast<std::int64_t>(bytes);
+    std::int64_t peak = c.peak.load(std::memory_order_relaxed);
+    while (live > peak && !c.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+}
+
+void record_free(const memory_tag tag, const std::size_t bytes, const std::uint64_t frees)
+{
+    tag_counters& c = counters[static_cast<std::size_t>(tag)];
+    c.frees.fetch_add(frees, std::memory_order_relaxed);
+    c.live.fetch_sub(static_cast<std::int64_t>(bytes), std::memory_order_relaxed);
+}
+
+memory_usage get_memory_usage(const memory_tag tag)
+{
+    const tag_counters& c = counters[static_cast<std::size_t>(tag)];
+    memory_usage usage;
+    usage.live_bytes = c.live.load(std::memory_order_relaxed);
+    usage.peak_bytes = c.peak.load(std::memory_order_relaxed);
+    usage.allocations = c.allocations.load(std::memory_order_relaxed);
+    usage.frees = c.frees.load(std::memory_order_relaxed);
+    return usage;
+}
+
+void reset_memory_peaks()
+{
+    for (tag_counters& c : counters)
+    {
+        c.peak.store(c.live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+const char* memory_tag_name(const memory_tag tag)
+{
+    switch (tag)
+    {
+        case memory_tag::input: return "input";
+        case memory_tag::sorted_sites: return "sorted_sites";
+        case memory_tag::events: return "events";
+        case memory_tag::beachline: return "beachline";
+        case memory_tag::half_edges: return "half_edges";
+        case memory_tag::edges: return "edges";
+        case memory_tag::vertices: return "vertices";
+        case memory_tag::cells: return "cells";
+        default: return "unknown";
+    }
+}
+
+void print_memory_report(std::ostream& os)
+{
+    const std::ios_base::fmtflags flags = os.flags();
+    os << std::left << std::setw(14) << "structure" << std::right << std::setw(14) << "live KiB" << std::setw(14) << "peak KiB"
+       << std::setw(14) << "allocations" << std::setw(14) << "frees" << "\n";
+    os << std::fixed << std::setprecision(1);
+    for (std::size_t tag = 0; tag < tag_count; tag++)
+    {
+        const memory_usage usage = get_memory_usage(static_cast<memory_tag>(tag));
+        os << std::left << std::setw(14) << memory_tag_name(static_cast<memory_tag>(tag)) << std::right
+           << std::setw(14) << static_cast<double>(usage.live_bytes) / 1024.0 << std::setw(14) << static_cast<double>(usage.peak_bytes) / 1024.0
+           << std::setw(14) << usage.allocations << std::setw(14) << usage.frees << "\n";
+    }
+    os.flags(flags);
+}
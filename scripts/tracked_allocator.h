@@ -0,0 +1,114 @@
+#pragma once
+//memory accounting per data structure of voronoi_diagram. every container is tagged with what it holds and its
+//allocations are counted under that tag: live bytes, the peak of those and the number of allocations and frees.
+//the counts are for the whole process, all diagrams together. print_memory_report shows them at any time.
+//containers whose type the diagram owns use tracked_allocator (or a pool_allocator on a tag, node_pool.h). the vectors
+//handed out as std::vector keep the std allocator, a capacity_account notes their block instead.
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <ostream>
+#include <vector>
+
+enum class memory_tag : std::uint8_t {
+    input,        //the copy of the caller's sites
+    sorted_sites, //site events in sweep order
+    events,       //event queue and waiting weighted sites
+    beachline,    //arcs and breakpoints
+    half_edges,   //open edges
+    edges,        //finished edges
+    vertices,
+    cells,        //cells of the per_cell engine
+    count
+};
+
+struct memory_usage {
+    std::int64_t live_bytes = 0;
+    std::int64_t peak_bytes = 0;
+    std::uint64_t allocations = 0;
+    std::uint64_t frees = 0;
+};
+
+void record_allocation(memory_tag tag, std::size_t bytes);
+void record_free(memory_tag tag, std::size_t bytes, std::uint64_t frees = 1);
+memory_usage get_memory_usage(memory_tag tag);
+void reset_memory_peaks(); //peaks start over from what is live now, e.g. before a run
+const char* memory_tag_name(memory_tag tag);
+void print_memory_report(std::ostream& os);
+
+//std allocator counting under Tag
+template<typename T, memory_tag Tag>
+class tracked_allocator {
+    public:
+        using value_type = T;
+        using is_always_equal = std::true_type;
+        template<typename U>
+        struct rebind {
+            using other = tracked_allocator<U, Tag>;
+        };
+
+        tracked_allocator() = default;
+        template<typename U>
+        tracked_allocator(const tracked_allocator<U, Tag>&) {}
+
+        T* allocate(const std::size_t n)
+        {
+            T* memory = static_cast<T*>(::operator new(n * sizeof(T)));
+            record_allocation(Tag, n * sizeof(T));
+            return memory;
+        }
+        void deallocate(T* memory, const std::size_t n)
+        {
+            record_free(Tag, n * sizeof(T));
+            ::operator delete(memory);
+        }
+
+        template<typename U>
+        bool operator==(const tracked_allocator<U, Tag>&) const {return true;}
+        template<typename U>
+        bool operator!=(const tracked_allocator<U, Tag>&) const {return false;}
+};
+
+template<typename T, memory_tag Tag>
+using tracked_vector = std::vector<T, tracked_allocator<T, Tag>>;
+
+//the heap block of a vector
+template<typename T, typename Allocator>
+std::size_t heap_bytes(const std::vector<T, Allocator>& vector) {return vector.capacity() * sizeof(T);}
+
+//accounts std::vectors from the outside: note() gets what their blocks add up to now (heap_bytes) and records the
+//change since the last call as a free and an allocation. a copy starts with nothing noted, what is noted is freed with
+//the account
+class capacity_account {
+    private:
+        memory_tag tag;
+        std::size_t noted = 0;
+    public:
+        explicit capacity_account(const memory_tag tag) : tag(tag) {}
+        capacity_account(const capacity_account& other) : tag(other.tag) {}
+        capacity_account& operator=(const capacity_account&) {return *this;}
+        ~capacity_account()
+        {
+            if (noted != 0)
+            {
+                record_free(tag, noted);
+            }
+        }
+
+        void note(const std::size_t bytes)
+        {
+            if (bytes != noted)
+            {
+                if (noted != 0)
+                {
+                    record_free(tag, noted);
+                }
+                if (bytes != 0)
+                {
+                    record_allocation(tag, bytes);
+                }
+                noted = bytes;
+            }
+        }
+};
@@ -0,0 +1,37 @@
+#pragma once
+//lock-free triple buffer for one writer thread and one reader thread.
+//the writer fills write_buffer() and calls publish(), the reader calls update() and then reads read_buffer().
+//neither side ever waits, the reader always gets the newest published value and skipped values are simply reused.
+
+#include <atomic>
+
+template<typename T>
+class triple_buffer {
+    public:
+        T& write_buffer() {return slots[back];}
+        void publish()
+        {
+            back = middle.exchange(back | fresh_bit, std::memory_order_acq_rel) & index_mask;
+        }
+
+        //returns true if a newer value than the current read_buffer() was taken
+        bool update()
+        {
+            if ((middle.load(std::memory_order_relaxed) & fresh_bit) == 0)
+            {
+                return false;
+            }
+            front = middle.exchange(front, std::memory_order_acq_rel) & index_mask;
+            return true;
+        }
+        const T& read_buffer() const {return slots[front];}
+
+    private:
+        static constexpr unsigned fresh_bit = 4;
+        static constexpr unsigned index_mask = 3;
+
+        T slots[3];
+        std::atomic<unsigned> middle{1};
+        unsigned back = 0;  //only touched by the writer
+        unsigned front = 2; //only touched by the reader
+};
@@ -115,7 +115,7 @@ std::ostream& operator<<(std::ostream& os, const std::vector<point>& active_arc_
     return os;
 }
 
-std::ostream& operator<<(std::ostream& os, const std::set<point, beachline::CompareByX>& breakpoints) {
+std::ostream& operator<<(std::ostream& os, const beachline::breakpoint_set& breakpoints) {
     os << "{";
     for (auto it = breakpoints.begin(); it != breakpoints.end(); ++it) {
         if (it != breakpoints.begin()) os << ", ";
@@ -125,16 +125,6 @@ std::ostream& operator<<(std::ostream& os, const std::set<point, beachline::Comp
     return os;
 }
 
-site_event& site_event::operator=(const site_event& other) {
-    if (this != &other) { // Prevent self-assignment
-        site = other.site;
-        isCircleEvent = other.isCircleEvent;
-        y = other.y;
-        circlePoints = other.circlePoints;
-    }
-    return *this;
-}
-
 bool site_event::operator<(const site_event& other) const
 {
     if (y != other.y)
@@ -143,15 +133,15 @@ bool site_event::operator<(const site_event& other) const
 }
 
 
-double calculate_y_parabola(const double x_parabola, const double x_site, const double y_site, const double y_sweepline) {
-    return (x_parabola*x_parabola - 2*x_parabola * x_site + x_site*x_site + y_site*y_site - y_sweepline*y_sweepline)/(2*y_site - 2*y_sweepline);
+double calculate_y_parabola(const double x_parabola, const double x_site, const double y_site, const double y_sweepline, const double weight) {
+    return (x_parabola*x_parabola - 2*x_parabola * x_site + x_site*x_site + y_site*y_site - weight - y_sweepline*y_sweepline)/(2*y_site - 2*y_sweepline);
 }
 
 double calculate_y_parabola_derivative(const double x_parabola, const double x_site, const double y_site, const double y_sweepline) {
     return (2*x_parabola-2*x_site)/(2*y_site - 2*y_sweepline);
 }
 
-double calculate_parabola_intersection(const point a, const point b, const double y_sweepline)
+double calculate_parabola_intersection(const point a, const point b, const double y_sweepline, const double a_weight, const double b_weight)
 {
     const double a_x_site = a.x;
     const double a_y_site = a.y;
@@ -161,11 +151,14 @@ double calculate_parabola_intersection(const point a, const point b, const doubl
     const double A = 2*(b_y_site-a_y_site);
     if (A == 0)
     {
-        return std::min(a_x_site,b_x_site) + (std::max(a_x_site, b_x_site) - std::min(a_x_site, b_x_site))/2; //avoid division by zero, take middle point between the two
+        //avoid division by zero, take middle point between the two. the power bisector is shifted towards the lighter site
+        const double shift = a_x_site == b_x_site ? 0.0 : (a_weight - b_weight) / (2*(b_x_site - a_x_site));
+        return std::min(a_x_site,b_x_site) + (std::max(a_x_site, b_x_site) - std::min(a_x_site, b_x_site))/2 + shift;
     }
     const double B = 4*(a_y_site*b_x_site-b_y_site*a_x_site+y_sweepline*a_x_site-y_sweepline*b_x_site);
-    const double C = (a_x_site*a_x_site + a_y_site*a_y_site - y_sweepline*y_sweepline)*(2*b_y_site - 2*y_sweepline) -
-               (b_x_site*b_x_site + b_y_site*b_y_site - y_sweepline*y_sweepline)*(2*a_y_site - 2*y_sweepline);
+    //the weights only move the arcs up or down, so they only show up in the constant term
+    const double C = (a_x_site*a_x_site + a_y_site*a_y_site - a_weight - y_sweepline*y_sweepline)*(2*b_y_site - 2*y_sweepline) -
+               (b_x_site*b_x_site + b_y_site*b_y_site - b_weight - y_sweepline*y_sweepline)*(2*a_y_site - 2*y_sweepline);
 
     const double discriminant = std::abs(B*B-4*A*C); //to make sure there is no error with the sqrt of a negative number, only happens with very small numbers so it doesn't matter
 
@@ -182,6 +175,34 @@ double calculate_parabola_intersection(const point a, const point b, const doubl
     }
 }
 
+double calculate_emergence(const point site, const double site_weight, const point arc_site, const double arc_weight, point& touch)
+{
+    const double nx = arc_site.x - site.x;
+    const double ny = arc_site.y - site.y;
+    const double length = std::sqrt(nx*nx + ny*ny);
+    if (length == 0)
+    {
+        touch = site;
+        return site.y + std::sqrt(std::max(0.0, -site_weight));
+    }
+    //bisector: points z with n . z = c, written as foot + s * d with foot the closest point to the site
+    const double c = (arc_site.x*arc_site.x + arc_site.y*arc_site.y - arc_weight - site.x*site.x - site.y*site.y + site_weight) * 0.5;
+    const double offset = (c - (nx*site.x + ny*site.y)) / length;
+    const point foot(site.x + nx / length * offset, site.y + ny / length * offset);
+    const double dx = -ny / length;
+    const double dy = nx / length;
+    //along the bisector the sweep time is foot.y + s * dy + sqrt(s^2 + h^2), its minimum is foot.y + h * |dx|
+    const double h = std::sqrt(std::max(0.0, offset*offset - site_weight));
+    if (dx == 0) //sites side by side, the arcs only meet infinitely far back
+    {
+        touch = foot;
+        return foot.y;
+    }
+    const double s = -dy * h / std::abs(dx);
+    touch = point(foot.x + dx * s, foot.y + dy * s);
+    return foot.y + h * std::abs(dx);
+}
+
 point mirror_point(const point mirror_point, const point A, const point B)
 {
     point projection(0,0);
@@ -203,20 +224,119 @@ point mirror_point(const point mirror_point, const point A, const point B)
     return mirrored;
 }
 
-circle circumcircle(const point A, const point B, const point C) {
+bool collinear(const point A, const point B, const point C) {
+    return A.x * (B.y - C.y) + B.x * (C.y - A.y) + C.x * (A.y - B.y) == 0;
+}
+
+circle circumcircle(const point A, const point B, const point C, const double a_weight, const double b_weight, const double c_weight) {
     const double determinant = (A.x * (B.y - C.y) + B.x * (C.y - A.y) + C.x * (A.y - B.y));
 
     if (determinant == 0) {
         throw std::invalid_argument("The points are colinear, no circumcircle exists");
     }
 
-    const double circumcenter_x = ((A.x*A.x + A.y*A.y)*(B.y-C.y) + (B.x*B.x + B.y*B.y)*(C.y-A.y) + (C.x*C.x + C.y*C.y)*(A.y-B.y)) / (2*determinant);
-    const double circumcenter_y = ((A.x*A.x + A.y*A.y)*(C.x-B.x) + (B.x*B.x + B.y*B.y)*(A.x-C.x) + (C.x*C.x + C.y*C.y)*(B.x-A.x)) / (2*determinant);
+    //|p|^2 - weight instead of |p|^2 turns the circumcentre into the power centre, the point with equal power to all three
+    const double a_lift = A.x*A.x + A.y*A.y - a_weight;
+    const double b_lift = B.x*B.x + B.y*B.y - b_weight;
+    const double c_lift = C.x*C.x + C.y*C.y - c_weight;
+    const double circumcenter_x = (a_lift*(B.y-C.y) + b_lift*(C.y-A.y) + c_lift*(A.y-B.y)) / (2*determinant);
+    const double circumcenter_y = (a_lift*(C.x-B.x) + b_lift*(A.x-C.x) + c_lift*(B.x-A.x)) / (2*determinant);
 
     const point circumcenter(circumcenter_x,circumcenter_y);
 
-    const double radius = std::sqrt((A.x-circumcenter_x) * (A.x-circumcenter_x) + (A.y-circumcenter_y)*(A.y-circumcenter_y));
+    const double radius = std::sqrt(std::max(0.0, (A.x-circumcenter_x) * (A.x-circumcenter_x) + (A.y-circumcenter_y)*(A.y-circumcenter_y) - a_weight));
     const circle circumcircle(circumcenter,radius);
 
     return circumcircle;
-}
\ No newline at end of file
+}
+
+cell make_box_cell(const point site, const double width, const double height)
+{
+    cell c(site);
+    c.polygon = {{0, 0}, {width, 0}, {width, height}, {0, height}};
+    c.neighbors = {-1, -1, -1, -1};
+    return c;
+}
+
+void make_box_cell(cell& c, const double width, const double height)
+{
+    c.polygon.clear();
+    c.polygon.insert(c.polygon.end(), {{0, 0}, {width, 0}, {width, height}, {0, height}});
+    c.neighbors.assign(4, -1);
+}
+
+void clip_cell(cell& c, const point neighbor, const int neighbor_index, const double weight_difference)
+{
+    //points x with (x - midpoint) . (neighbor - site) + weight_difference / 2 <= 0 are closer to the site
+    const double nx = neighbor.x - c.site.x;
+    const double ny = neighbor.y - c.site.y;
+    const double mx = (neighbor.x + c.site.x) * 0.5;
+    const double my = (neighbor.y + c.site.y) * 0.5;
+    const double shift = weight_difference * 0.5;
+    const auto side = [&](const point& p) {return (p.x - mx) * nx + (p.y - my) * ny + shift;};
+
+    const std::size_t count = c.polygon.size();
+    bool any_outside = false;
+    for (const point& p : c.polygon)
+    {
+        if (side(p) > 0)
+        {
+            any_outside = true;
+            break;
+        }
+    }
+    if (!any_outside)
+    {
+        return;
+    }
+
+    //Sutherland-Hodgman against one half-plane, each output vertex keeps the label of the edge leaving it
+    //swapped with the cell's own buffers at the end, so repeated clipping allocates nothing once they are large enough
+    thread_local std::vector<point> polygon;
+    thread_local std::vector<int> neighbors;
+    polygon.clear();
+    neighbors.clear();
+    polygon.reserve(count + 1);
+    neighbors.reserve(count + 1);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const point& current = c.polygon[i];
+        const point& next = c.polygon[(i + 1) % count];
+        const double current_side = side(current);
+        const double next_side = side(next);
+        if (current_side <= 0)
+        {
+            polygon.push_back(current);
+            neighbors.push_back(c.neighbors[i]);
+        }
+        if ((current_side <= 0) != (next_side <= 0))
+        {
+            const double t = current_side / (current_side - next_side);
+            polygon.emplace_back(current.x + (next.x - current.x) * t, current.y + (next.y - current.y) * t);
+            neighbors.push_back(current_side <= 0 ? neighbor_index : c.neighbors[i]);
+        }
+    }
+    c.polygon.swap(polygon);
+    c.neighbors.swap(neighbors);
+}
+
+point polygon_centroid(const std::vector<point>& polygon)
+{
+    double area = 0;
+    double cx = 0;
+    double cy = 0;
+    for (std::size_t i = 0; i < polygon.size(); i++)
+    {
+        const point& a = polygon[i];
+        const point& b = polygon[(i + 1) % polygon.size()];
+        const double cross = a.x * b.y - b.x * a.y;
+        area += cross;
+        cx += (a.x + b.x) * cross;
+        cy += (a.y + b.y) * cross;
+    }
+    if (area == 0)
+    {
+        return polygon.empty() ? point(0, 0) : polygon.front();
+    }
+    return {cx / (3 * area), cy / (3 * area)};
+}
@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include "node_pool.h"
+
+#include <array>
 #include <utility>
 #include <vector>
 #include <set>
@@ -23,6 +26,12 @@ struct point {
 
 };
 
+//orders points by x and then y, for maps keyed by site position
+struct CompareByXY
+{
+    bool operator()(const point& lhs, const point& rhs) const {return lhs.x < rhs.x || (lhs.x == rhs.x && lhs.y < rhs.y);}
+};
+
 struct circle {
     point center;
     double radius;
@@ -48,8 +57,17 @@ struct vector2D {
 struct edge {
     point start;
     point end;
+    std::pair<point,point> arc_sites; //the two sites the edge separates
+
+    edge(const point start, const point end, std::pair<point,point> sites) : start(start), end(end), arc_sites(std::move(sites)) {};
+};
 
-    edge(const point start, const point end) : start(start), end(end) {};
+struct cell { //convex polygon around one site, vertices in order
+    point site;
+    std::vector<point> polygon;
+    std::vector<int> neighbors; //index of the site across the edge polygon[i] -> polygon[i+1], -1 for the bounding box
+
+    explicit cell(const point site) : site(site) {}
 };
 
 struct sweepline {
@@ -74,12 +92,15 @@ class beachline {
         {
             bool operator()(const point& lhs, const point& rhs) const {return lhs.x < rhs.x;}
         };
-        std::vector<point> active_arc_sites; //arc growing from corresponding site
-        std::set<point, CompareByX> breakpoints; //splits the beachline up by x-value
-        std::vector<vector2D> breakpoint_vectors;
+        using breakpoint_set = std::set<point, CompareByX, pool_allocator<point, memory_tag::beachline>>; //rebuilt every event, pooled nodes
+        using arc_list = tracked_vector<point, memory_tag::beachline>;
+        arc_list active_arc_sites; //arc growing from corresponding site
+        tracked_vector<double, memory_tag::beachline> arc_weights; //of active_arc_sites in a weighted sweep, empty otherwise
+        breakpoint_set breakpoints; //splits the beachline up by x-value
+        tracked_vector<vector2D, memory_tag::beachline> breakpoint_vectors;
         int new_arc_site_index = 0;
         int getBreakpointPlacementIndex(const point& p) const; //returns the correct index for the active arc-site to be placed.
-        friend std::ostream& operator<<(std::ostream& os, const std::set<point, CompareByX>& breakpoints);
+        friend std::ostream& operator<<(std::ostream& os, const breakpoint_set& breakpoints);
 };
 
 std::ostream& operator<<(std::ostream& os, const std::vector<point>& active_arc_sites);
@@ -89,27 +110,50 @@ public:
         point site;
         bool isCircleEvent; //when three site-lines intersect
         double y;
-        std::vector<point> circlePoints;
-        double radius=0;
+        //the three arc sites of a circle event, the site itself three times otherwise. a weighted site that has been
+        //through power_cell_start keeps where it comes up in the middle one
+        std::array<point, 3> circlePoints;
+        double radius=0; //of the circle of a circle event, its site is the centre
     public:
-        site_event() : site(0,0), isCircleEvent(false) , y(0.0), circlePoints({}){}
-        site_event(const point p, const bool isSiteEvent, const double y, const std::vector<point>& points={}): site(p), isCircleEvent(isSiteEvent), y(y), circlePoints(points) {};
+        site_event() : site(0,0), isCircleEvent(false) , y(0.0), circlePoints{{site, site, site}}{}
+        site_event(const point p, const bool isSiteEvent, const double y): site(p), isCircleEvent(isSiteEvent), y(y), circlePoints{{p, p, p}} {};
+        site_event(const point p, const bool isSiteEvent, const double y, const std::array<point, 3>& points): site(p), isCircleEvent(isSiteEvent), y(y), circlePoints(points) {};
         bool operator<(const site_event& other) const;
-        site_event& operator=(const site_event& other);
+        site_event(const site_event& other) = default;
+        site_event& operator=(const site_event& other) = default;
         double getY() const {return y;}
         point getSite() const {return site;}
         bool getIsCircleEvent() const {return isCircleEvent;}
-        point getCirclePoints(const int it) const {return circlePoints.at(it);}
+        point getCirclePoints(const int it) const {return circlePoints[it];}
 };
 
-double calculate_y_parabola(double x_parabola, double x_site, double y_site, double y_sweepline);
+//weight <= 0 shifts the arc back by -weight / (2 * (y_sweepline - y_site)), the arc of a power diagram site
+double calculate_y_parabola(double x_parabola, double x_site, double y_site, double y_sweepline, double weight = 0.0);
 
 double calculate_y_parabola_derivative(double x_parabola,double x_site,double y_site,double y_sweepline);
 
 
-double calculate_parabola_intersection(point a, point b, double y_sweepline);
+//the weights are those of power diagram sites, see calculate_y_parabola
+double calculate_parabola_intersection(point a, point b, double y_sweepline, double a_weight = 0.0, double b_weight = 0.0);
+
+//sweepline y where the arc of a weighted site first touches the arc of arc_site, touch is the point where they touch.
+//the sweep reaches z at z.y + sqrt(|z - site|^2 - weight), this is the smallest value of that along their power bisector
+double calculate_emergence(point site, double site_weight, point arc_site, double arc_weight, point& touch);
 
 //mirror a point on the line AB - useful for getting "sister" circle-sites incase it is
 point mirror_point(point mirror_point, point A, point B);
 
-circle circumcircle(point A, point B, point C);
+bool collinear(point A, point B, point C); //on one line, circumcircle has nothing to give for them
+//for weighted points this is the power centre, radius is the square root of the power there (weights must be <= 0)
+circle circumcircle(point A, point B, point C, double a_weight = 0.0, double b_weight = 0.0, double c_weight = 0.0);
+
+//cell covering the box [0,width] x [0,height], to be cut down with clip_cell
+cell make_box_cell(point site, double width, double height);
+void make_box_cell(cell& c, double width, double height); //the same over c, keeping its site and the memory of its vectors
+
+//cuts away the part of the cell closer to neighbor than to the cell's site. weight_difference is the neighbour's weight
+//minus the site's, the cut is then in power distance
+void clip_cell(cell& c, point neighbor, int neighbor_index, double weight_difference = 0.0);
+
+//area weighted centroid of a simple polygon, the first vertex if the area is zero
+point polygon_centroid(const std::vector<point>& polygon);
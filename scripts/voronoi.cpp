@@ -3,19 +3,144 @@
 //
 
 #include "voronoi.h"
+#include "cell_engine.h"
+#include "geometry_batch.h"
+#include "parallel.h"
+#include "radix_sort.h"
+#include "spatial_sort.h"
+#include "sweep_trace.h"
 #include "utilities.h"
+#include "triple_buffer.h"
 #include <SDL.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstdlib>
 #include <vector>
 #include <random>
+#include <string>
+#include <thread>
 
 #include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
 
-voronoi_diagram::voronoi_diagram(std::vector<point> input_points) : input_points(std::move(input_points)), num_input_points(input_points.size()), sweepline(0.0){
-    for (const point& p : this->input_points)
+namespace {
+    constexpr std::size_t first_power_neighbors = 16; //nearest sites power_cell_start cuts a cell with before it checks
+
+    //sites in the order the sweep meets them: by y, then x like site_event::operator<. of sites at the same spot only the
+    //first one is kept, as inserting them into the std::set of events did. the buffers are kept for the next call
+    void sweep_order(const std::vector<point>& points, tracked_vector<point, memory_tag::sorted_sites>& sorted)
+    {
+        using keyed_site = std::pair<std::uint64_t, int>;
+        thread_local std::vector<keyed_site> kept_keyed, kept_buffer;
+        std::vector<keyed_site>& keyed = kept_keyed; //references, the workers of parallel_for have their own thread_locals
+        keyed.resize(points.size());
+        parallel_for(0, points.size(), [&](const std::size_t i) {
+            keyed[i] = {radix_key(points[i].y), static_cast<int>(i)};
+        }, 1 << 14);
+        radix_sort(keyed, [](const keyed_site& item) {return item.first;}, 64, kept_buffer);
+
+        sorted.clear();
+        sorted.reserve(points.size());
+        for (std::size_t begin = 0, end = 0; begin < keyed.size(); begin = end)
+        {
+            //equal y is rare, those runs are put in x order afterwards (stable, so the first of equal sites stays first)
+            for (end = begin + 1; end < keyed.size() && keyed[end].first == keyed[begin].first; end++) {}
+            if (end - begin > 1)
+            {
+                std::stable_sort(keyed.begin() + begin, keyed.begin() + end, [&](const keyed_site& a, const keyed_site& b) {
+                    return points[a.second].x < points[b.second].x;
+                });
+            }
+            for (std::size_t i = begin; i < end; i++)
+            {
+                const point& p = points[keyed[i].second];
+                if (i == begin || !(sorted.back().x == p.x))
+                {
+                    sorted.push_back(p);
+                }
+            }
+        }
+    }
+}
+
+voronoi_diagram::voronoi_diagram(std::vector<point> input_points) : input_points(std::move(input_points)), sweepline(0.0){
+    num_input_points = this->input_points.size();
+    prepare_sites();
+}
+
+//the site events sorted and the weights prepared, for whatever is in input_points
+void voronoi_diagram::prepare_sites()
+{
+    sweep_order(input_points, sorted_sites);
+    next_sorted_site = 0;
+    prepare_weights();
+    note_memory();
+}
+
+//weights moved to <= 0 and looked up by position, the arcs of the sweep are only points
+void voronoi_diagram::prepare_weights()
+{
+    //adding the same amount to every weight does not change a power diagram, so the heaviest site is moved to 0.
+    //with all weights <= 0 every power distance is a real distance. a weighted site can not reach the beachline before
+    //the sweepline passes its y, so its event starts there and emerge_weighted_site works out the real time
+    weighted = false;
+    for (const double weight : weights)
+    {
+        weighted = weighted || weight != 0.0;
+    }
+    weight_lookup.clear();
+    power_sites.clear(); //power_cell_start takes them from sorted_sites again
+    power_weights.clear();
+    if (!weighted)
+    {
+        weights.clear();
+        return;
+    }
+    weights.resize(input_points.size(), 0.0);
+    const double max_weight = *std::max_element(weights.begin(), weights.end());
+    for (std::size_t i = 0; i < weights.size(); i++)
+    {
+        weights[i] -= max_weight;
+        weight_lookup.emplace_back(input_points[i], weights[i]);
+    }
+    //stable, so of equal sites the first one comes first like in sweep_order
+    std::stable_sort(weight_lookup.begin(), weight_lookup.end(), [](const std::pair<point, double>& a, const std::pair<point, double>& b) {
+        return CompareByXY()(a.first, b.first);
+    });
+}
+
+double voronoi_diagram::weight_of(const point& site) const
+{
+    if (!weighted)
     {
-        event_queue.emplace(p,false,p.y);
+        return 0.0;
     }
+    const auto found = std::lower_bound(weight_lookup.begin(), weight_lookup.end(), site, [](const std::pair<point, double>& entry, const point& p) {
+        return CompareByXY()(entry.first, p);
+    });
+    return found != weight_lookup.end() && !CompareByXY()(site, found->first) ? found->second : 0.0;
+}
+
+void voronoi_diagram::set_weights(std::vector<double> new_weights)
+{
+    weights = std::move(new_weights);
+    prepare_weights();
+    note_memory();
+}
+
+voronoi_diagram::voronoi_diagram(std::vector<point> input_points, const int width, const int height) : voronoi_diagram(std::move(input_points)) {
+    display_w = width;
+    display_h = height;
+}
+
+voronoi_diagram::voronoi_diagram(std::vector<point> input_points, std::vector<double> weights, const int width, const int height)
+    : voronoi_diagram(std::move(input_points), width, height) {
+    set_weights(std::move(weights));
 }
 
 voronoi_diagram::voronoi_diagram() : voronoi_diagram(std::vector<point>{}) {
@@ -37,45 +162,123 @@ voronoi_diagram::voronoi_diagram() : voronoi_diagram(std::vector<point>{}) {
         std::cout << points[i] << " ";
     }
     std::cout << std::endl;
-    *this = voronoi_diagram(points);
+    reset(points);
+}
 
+void voronoi_diagram::reset(const std::vector<point>& points)
+{
+    reset(points.data(), points.size());
 }
 
-void voronoi_diagram::next_site() {
-    if (event_queue.empty())
+void voronoi_diagram::reset(const point* points, const std::size_t count)
+{
+    //everything is cleared in place, the vectors keep their capacity and the sets keep the blocks of their pools
+    input_points.assign(points, points + count);
+    num_input_points = count;
+    weights.clear();
+    caller_ids.clear();
+    event_queue.clear();
+    current_event = site_event();
+    half_edges.clear();
+    diagram_edges.clear();
+    vertices.clear();
+    off_frame_neighbors.clear();
+    beachline.active_arc_sites.clear();
+    beachline.arc_weights.clear();
+    beachline.breakpoints.clear();
+    beachline.breakpoint_vectors.clear();
+    beachline.new_arc_site_index = 0;
+    sweepline.y = 0.0;
+    waiting_sites.clear();
+    engine_cells.clear();
+    cell_memory.note(heap_bytes(engine_cells));
+    events_run = 0;
+    circle_events_added = 0;
+    circle_events_cancelled = 0;
+    prepare_sites();
+}
+
+bool voronoi_diagram::events_left() const
+{
+    return next_sorted_site < sorted_sites.size() || !event_queue.empty();
+}
+
+//the next event is the earlier of the next sorted site and the first queued event, the site on a tie
+bool voronoi_diagram::next_is_queued() const
+{
+    if (next_sorted_site == sorted_sites.size())
+    {
+        return true;
+    }
+    const point& site = sorted_sites[next_sorted_site];
+    return !event_queue.empty() && (event_queue.begin()->y < site.y || (event_queue.begin()->y == site.y && event_queue.begin()->getSite().x < site.x));
+}
+
+site_event voronoi_diagram::peek_event() const
+{
+    if (next_is_queued())
     {
-        std::cerr << "Error in voronoi_diagram::next_site(), event_queue empty" << std::endl;
+        return *event_queue.begin();
     }
-    if (event_queue.begin()->getSite().y>display_h+1)
+    const point& site = sorted_sites[next_sorted_site];
+    return {site, false, site.y};
+}
+
+void voronoi_diagram::pop_event()
+{
+    if (next_is_queued())
     {
         event_queue.erase(event_queue.begin());
-        if (!event_queue.empty())
+    }
+    else
+    {
+        next_sorted_site++;
+    }
+}
+
+void voronoi_diagram::next_site() {
+    trace_scope scope(tracer, trace_phase::next_site);
+    if (!events_left())
+    {
+        std::cerr << "Error in voronoi_diagram::next_site(), no events left" << std::endl;
+        return;
+    }
+    //circle events with their vertex off screen are skipped, except in a weighted sweep: a weighted site coming up looks
+    //at the whole beachline, arcs left there by a skipped event would be in the way
+    const site_event next = peek_event();
+    const bool keep = weighted && next.getIsCircleEvent();
+    if (!keep && next.getSite().y>display_h+1)
+    {
+        pop_event();
+        if (events_left())
         {
             next_site();
         }
         return;
     }
-    if (event_queue.begin()->getSite().x>display_w+1 || event_queue.begin()->getSite().x<-1)
+    if (!keep && (next.getSite().x>display_w+1 || next.getSite().x<-1))
     {
-        event_queue.erase(event_queue.begin());
-        if (!event_queue.empty())
+        pop_event();
+        if (events_left())
         {
             next_site();
         }
         return;
     }
-    current_event = *event_queue.begin();
+    current_event = next;
     sweepline.y = current_event.y + sweepline_epsilon; //TODO: Add sweepline_epsilon when using it
-    event_queue.erase(event_queue.begin());
+    pop_event();
 }
 
 //TODO: Make a smaller function that contains the point sorting.
 void voronoi_diagram::add_circle_event(point p1, point p2, point p3, const bool ordered = false) { //order matters - i,i+1,i+2
-    if (p1==p2 || p2==p3 || p3==p1)
+    trace_scope scope(tracer, trace_phase::add_circle_event);
+    //arcs of sites on one line never squeeze the middle one out, there is no event to add
+    if (p1==p2 || p2==p3 || p3==p1 || collinear(p1, p2, p3))
     {
         return;
     }
-    const circle c = circumcircle(p1, p2, p3);
+    const circle c = circumcircle(p1, p2, p3, weight_of(p1), weight_of(p2), weight_of(p3));
     const point p = {c.center.x, c.center.y};
     if (!ordered)
     {
@@ -100,9 +303,9 @@ void voronoi_diagram::add_circle_event(point p1, point p2, point p3, const bool
     if(p.y+c.radius > sweepline.y) { //TODO: optimise
         for (auto it = event_queue.begin(); it != event_queue.end();)
         {
-            if (it->circlePoints.empty()) {
+            if (!it->getIsCircleEvent()) {
                 ;
-            } else if(it->circlePoints.at(0)==p1 && it->circlePoints.at(1)==p2 && it->circlePoints.at(2)==p3) {
+            } else if(it->circlePoints[0]==p1 && it->circlePoints[1]==p2 && it->circlePoints[2]==p3) {
                 return;
             }
             ++it;
@@ -110,15 +313,17 @@ void voronoi_diagram::add_circle_event(point p1, point p2, point p3, const bool
         site_event site_event{p, true,p.y + c.radius, {p1,p2,p3}};
         site_event.radius = c.radius;
         event_queue.insert(site_event); //order matters here
+        circle_events_added++;
     }
 }
 
 void voronoi_diagram::remove_circle_event(point p1, point p2, point p3, bool ordered = false) {
-    if (p1==p2 || p2==p3 || p3==p1)
+    trace_scope scope(tracer, trace_phase::remove_circle_event);
+    if (p1==p2 || p2==p3 || p3==p1 || collinear(p1, p2, p3))
     {
         return;
     }
-    const circle c = circumcircle(p1, p2, p3);
+    const circle c = circumcircle(p1, p2, p3, weight_of(p1), weight_of(p2), weight_of(p3));
     const point p = {c.center.x, c.center.y + c.radius};
 
     if (!ordered)
@@ -143,10 +348,11 @@ void voronoi_diagram::remove_circle_event(point p1, point p2, point p3, bool ord
     if(p.y > sweepline.y) { //TODO: optimise
         for (auto it = event_queue.begin(); it != event_queue.end();)
         {
-            if (it->circlePoints.empty()) {
+            if (!it->getIsCircleEvent()) {
                 ;
-            } else if(it->circlePoints.at(0)==p1 && it->circlePoints.at(1)==p2 && it->circlePoints.at(2)==p3) {
+            } else if(it->circlePoints[0]==p1 && it->circlePoints[1]==p2 && it->circlePoints[2]==p3) {
                 event_queue.erase(it);
+                circle_events_cancelled++;
                 return;
             }
             ++it;
@@ -189,6 +395,10 @@ bool voronoi_diagram::remove_arc_site_at_intersection() {
     for (auto it = beachline.active_arc_sites.rbegin(); it != beachline.active_arc_sites.rend() - 2;) {
         if (*it == p3 && *(it + 1) == p2 && *(it + 2) == p1) {
             // Erase the middle site (p2)
+            if (weighted)
+            {
+                beachline.arc_weights.erase(beachline.arc_weights.begin() + ((it+2).base() - beachline.active_arc_sites.begin()));
+            }
             auto const forward_it = beachline.active_arc_sites.erase((it+2).base());
 
             if (forward_it-1 != beachline.active_arc_sites.begin()) {
@@ -209,9 +419,13 @@ bool voronoi_diagram::remove_arc_site_at_intersection() {
 
 void voronoi_diagram::generate_half_edges_at_new_site()
 {
+    trace_scope scope(tracer, trace_phase::half_edges);
     const point p1 = current_event.getCirclePoints(0);
     const point p2 = current_event.getCirclePoints(1); // the one removed
     const point p3 = current_event.getCirclePoints(2);
+    const double w1 = weight_of(p1);
+    const double w2 = weight_of(p2);
+    const double w3 = weight_of(p3);
 
     const std::pair<point, point> arc1(std::min(p1, p2), std::max(p1, p2)); //old breakpoint
     const std::pair<point, point> arc2(std::min(p2, p3), std::max(p2, p3)); //old breakpoint
@@ -220,16 +434,15 @@ void voronoi_diagram::generate_half_edges_at_new_site()
     bool arc1_removed = false;
     bool arc2_removed = false;
 
-    const double temp = current_event.getSite().y;
-    current_event.site.y = current_event.site.y - current_event.radius;
+    vertices.push_back(current_event.site); //the centre of the circle
     for (auto it = half_edges.begin(); it != half_edges.end(); )
     {
         if (it->arc_sites == arc1) {
-            diagram_edges.emplace_back(it->start, current_event.site);
+            diagram_edges.emplace_back(it->start, current_event.site, it->arc_sites);
             it = half_edges.erase(it); // Safely erase and get the next iterator
             arc1_removed = true;
         } else if (it->arc_sites == arc2) {
-            diagram_edges.emplace_back(it->start, current_event.site);
+            diagram_edges.emplace_back(it->start, current_event.site, it->arc_sites);
             it = half_edges.erase(it); // Safely erase and get the next iterator
             arc2_removed = true;
         } else {
@@ -237,32 +450,32 @@ void voronoi_diagram::generate_half_edges_at_new_site()
         }
     }
     if (!arc1_removed) {
-        const double x = calculate_parabola_intersection(p2, p1, sweepline.y);
-        const double y = calculate_y_parabola(x, p1.x, p1.y, sweepline.y);
+        const double x = calculate_parabola_intersection(p2, p1, sweepline.y, w2, w1);
+        const double y = calculate_y_parabola(x, p1.x, p1.y, sweepline.y, w1);
         vector2D direction(x-current_event.getSite().x, y-current_event.getSite().y);
         direction.normalize();
         half_edges.emplace(current_event.getSite(), sweepline.y, direction, arc1);
     }
 
     if (!arc2_removed) {
-        const double x = calculate_parabola_intersection(p3, p2, sweepline.y);
-        const double y = calculate_y_parabola(x, p3.x, p2.y, sweepline.y);
+        const double x = calculate_parabola_intersection(p3, p2, sweepline.y, w3, w2);
+        const double y = calculate_y_parabola(x, p3.x, p3.y, sweepline.y, w3);
         vector2D direction(x-current_event.getSite().x, y-current_event.getSite().y);
         direction.normalize();
         half_edges.emplace(current_event.getSite(), sweepline.y, direction, arc2);
     }
 
     // Create a new half-edge for the third intersection
-    const double x = calculate_parabola_intersection(p3, p1, sweepline.y);
-    const double y = calculate_y_parabola(x, p1.x, p1.y, sweepline.y);
+    const double x = calculate_parabola_intersection(p3, p1, sweepline.y, w3, w1);
+    const double y = calculate_y_parabola(x, p1.x, p1.y, sweepline.y, w1);
     vector2D direction(current_event.getSite().x-x, current_event.getSite().y-y);
     direction.normalize();
     half_edges.emplace(current_event.getSite(), sweepline.y, direction, arc3);
-    current_event.site.y = temp;
 }
 
 void voronoi_diagram::complete_edges()
 {
+    trace_scope scope(tracer, trace_phase::complete_edges);
     for (auto it = half_edges.begin(); it != half_edges.end(); )
     {
         const point start = it->start;
@@ -287,13 +500,162 @@ void voronoi_diagram::complete_edges()
         point end = start + direction * std::min(t1,t2);
         if (start.x < display_w && start.y < display_h && start.x > 0 && start.y > 0)
         {
-            diagram_edges.emplace_back(start, end);
+            diagram_edges.emplace_back(start, end, it->arc_sites);
+        }
+        else
+        {
+            off_frame_neighbors.push_back(it->arc_sites);
         }
         it = half_edges.erase(it);
     }
+    record_telemetry();
+    note_memory();
+}
+
+void voronoi_diagram::record_telemetry()
+{
+    if (telemetry == nullptr)
+    {
+        return;
+    }
+    telemetry_sample sample;
+    sample.sweepline_y = sweepline.y;
+    sample.events = events_run;
+    sample.arcs = beachline.active_arc_sites.size();
+    sample.queued_events = event_queue.size();
+    sample.circle_events = circle_events_added;
+    sample.cancelled_events = circle_events_cancelled;
+    sample.edges = diagram_edges.size();
+    telemetry->record(sample);
+}
+
+void voronoi_diagram::note_memory()
+{
+    input_memory.note(heap_bytes(input_points) + heap_bytes(weights) + heap_bytes(weight_lookup) + heap_bytes(caller_ids));
+    edge_memory.note(heap_bytes(diagram_edges));
+    vertex_memory.note(heap_bytes(vertices));
+}
+
+void voronoi_diagram::order_sites_spatially()
+{
+    //events hold the points themselves, not indices, so the queue does not change
+    const std::vector<int> order = hilbert_order(input_points);
+    std::vector<point> ordered;
+    std::vector<double> ordered_weights;
+    std::vector<int> ids;
+    ordered.reserve(order.size());
+    ordered_weights.reserve(weights.size());
+    ids.reserve(order.size());
+    for (const int i : order)
+    {
+        ordered.push_back(input_points[i]);
+        if (!weights.empty())
+        {
+            ordered_weights.push_back(weights[i]);
+        }
+        ids.push_back(get_caller_id(i));
+    }
+    input_points = std::move(ordered);
+    weights = std::move(ordered_weights);
+    caller_ids = std::move(ids);
+    note_memory();
+}
+
+std::vector<cell> voronoi_diagram::build_cells() const
+{
+    std::vector<cell> cells;
+    build_cells(cells);
+    return cells;
+}
+
+void voronoi_diagram::build_cells(std::vector<cell>& cells) const
+{
+    if (engine == voronoi_engine::per_cell)
+    {
+        cells = engine_cells;
+        return;
+    }
+    //every edge of the diagram tells us two sites are neighbours. the cells are then the bounding box clipped by the
+    //bisector of each neighbour, which gives closed polygons even where an edge was cut at the frame.
+    //the lookup and neighbour lists are kept for the next call, like the polygons already in cells
+    const int count = static_cast<int>(input_points.size());
+    thread_local std::vector<std::pair<point, int>> site_index; //sorted by position, the first index of each position first
+    thread_local std::vector<std::pair<int, int>> pairs;
+    thread_local std::vector<int> around;
+    site_index.clear();
+    for (int i = 0; i < count; i++)
+    {
+        site_index.emplace_back(input_points[i], i);
+    }
+    std::sort(site_index.begin(), site_index.end(), [](const std::pair<point, int>& a, const std::pair<point, int>& b) {
+        return CompareByXY()(a.first, b.first) || (!CompareByXY()(b.first, a.first) && a.second < b.second);
+    });
+    const auto find_site = [&](const point& site) {
+        const auto found = std::lower_bound(site_index.begin(), site_index.end(), site, [](const std::pair<point, int>& entry, const point& p) {
+            return CompareByXY()(entry.first, p);
+        });
+        return found != site_index.end() && !CompareByXY()(site, found->first) ? found->second : -1;
+    };
+    pairs.clear();
+    const auto add_neighbors = [&](const std::pair<point, point>& arc_sites) {
+        const int a = find_site(arc_sites.first);
+        const int b = find_site(arc_sites.second);
+        if (a >= 0 && b >= 0 && a != b)
+        {
+            pairs.emplace_back(a, b);
+            pairs.emplace_back(b, a);
+        }
+    };
+    for (const edge& diagram_edge : diagram_edges)
+    {
+        add_neighbors(diagram_edge.arc_sites);
+    }
+    for (const half_edge& open_edge : half_edges)
+    {
+        add_neighbors(open_edge.arc_sites);
+    }
+    for (const std::pair<point, point>& arc_sites : off_frame_neighbors)
+    {
+        add_neighbors(arc_sites);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    cells.resize(input_points.size(), cell(point(0, 0)));
+    std::size_t next_pair = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const point& site = input_points[i];
+        around.clear();
+        for (; next_pair < pairs.size() && pairs[next_pair].first == i; next_pair++)
+        {
+            around.push_back(pairs[next_pair].second);
+        }
+        cell& c = cells[i];
+        c.site = site;
+        c.polygon.clear();
+        c.neighbors.clear();
+        //duplicates and sites next_site skips have no cell
+        if (find_site(site) != i || around.empty() || site.y > display_h+1 || site.x > display_w+1 || site.x < -1)
+        {
+            continue;
+        }
+        //closest neighbours first, they cut away the most
+        std::sort(around.begin(), around.end(), [&](const int a, const int b) {
+            const double da = (input_points[a].x - site.x) * (input_points[a].x - site.x) + (input_points[a].y - site.y) * (input_points[a].y - site.y);
+            const double db = (input_points[b].x - site.x) * (input_points[b].x - site.x) + (input_points[b].y - site.y) * (input_points[b].y - site.y);
+            return da < db;
+        });
+        make_box_cell(c, display_w, display_h);
+        for (const int neighbor : around)
+        {
+            clip_cell(c, input_points[neighbor], neighbor, weights.empty() ? 0.0 : weights[neighbor] - weights[i]);
+        }
+    }
 }
 
 void voronoi_diagram::update_beachline() {
+    trace_scope scope(tracer, trace_phase::update_beachline);
     if (current_event.getIsCircleEvent())
     {
         if (remove_arc_site_at_intersection())
@@ -304,9 +666,22 @@ void voronoi_diagram::update_beachline() {
     else if (!beachline.active_arc_sites.empty()) //if it is a regular site event
     {
         //need to place the new site in active_arc_sites at the correct index given the breakline x-values
-        const int Index = beachline.getBreakpointPlacementIndex(current_event.getSite());
+        int Index = 0;
+        bool at_breakpoint = false;
+        if (!weighted)
+        {
+            Index = beachline.getBreakpointPlacementIndex(current_event.getSite());
+        }
+        else if (!emerge_weighted_site(Index, at_breakpoint))
+        {
+            return;
+        }
+        if (at_breakpoint)
+        {
+            insert_at_breakpoint(Index);
+        }
         //split old active_site_beachline in two
-        if (Index >= 0 && Index <= beachline.active_arc_sites.size()) {
+        else if (Index >= 0 && Index <= beachline.active_arc_sites.size()) {
             // Get the iterator to the position where 'Index' points
             auto iter = beachline.active_arc_sites.begin() + Index;
 
@@ -316,6 +691,11 @@ void voronoi_diagram::update_beachline() {
 
             // Insert a duplicate of the site at 'Index' right after the new site
             beachline.active_arc_sites.insert(iter + 1, beachline.active_arc_sites.at(Index));
+            if (weighted)
+            {
+                const double split_weight = beachline.arc_weights.at(Index);
+                beachline.arc_weights.insert(beachline.arc_weights.begin() + Index + 1, {weight_of(current_event.getSite()), split_weight});
+            }
             update_circle_event();
         } else {
             std::cerr << "Index out of bounds: " << Index << " Size: " << beachline.active_arc_sites.size() << std::endl;
@@ -324,6 +704,10 @@ void voronoi_diagram::update_beachline() {
     else if (beachline.active_arc_sites.empty()) //if the arc_sites vector is empty
     {
         beachline.active_arc_sites.push_back(current_event.getSite());
+        if (weighted)
+        {
+            beachline.arc_weights.push_back(weight_of(current_event.getSite()));
+        }
         beachline.breakpoints.emplace(display_w,0);
     } else
     {
@@ -334,20 +718,374 @@ void voronoi_diagram::update_beachline() {
 
 }
 
-void voronoi_diagram::update_breakpoints() {
-    beachline.breakpoints.clear();
+//how far the arc of a weighted site is above the beachline at its highest, for the arcs as they are now but the
+//sweepline at y (<= 0 when it is nowhere above). x is where the site comes up (power_cell_start), only the arc over it
+//and the arcs next to that one are looked at. arc and at_breakpoint tell where: in the middle of arc, or where arc and
+//arc + 1 meet
+double voronoi_diagram::weighted_site_peak(const point& site, const double weight, const double y, const double x, int& arc, bool& at_breakpoint) const
+{
+    const beachline::arc_list& arcs = beachline.active_arc_sites;
+    const auto& weights_of_arcs = beachline.arc_weights;
+    const int count = static_cast<int>(arcs.size());
+    //where arc i and i + 1 meet, the ends of the beachline as far out as we look
+    const auto breakpoint = [&](const int i) {
+        if (i < 0)
+        {
+            return -10.0 * display_w;
+        }
+        return i + 1 < count ? calculate_parabola_intersection(arcs[i], arcs[i+1], y, weights_of_arcs[i], weights_of_arcs[i+1]) : 11.0 * display_w;
+    };
+    //binary search for the first arc ending right of x. the breakpoints are in order, only those of squeezed arcs can
+    //cross by rounding, and the neighbours below cover that
+    int over = 0;
+    for (int high = count - 1; over < high;)
+    {
+        const int middle = over + (high - over) / 2;
+        if (breakpoint(middle) > x)
+        {
+            high = middle;
+        }
+        else
+        {
+            over = middle + 1;
+        }
+    }
+    double best = 0.0;
+    at_breakpoint = false;
+    for (int i = std::max(0, over - 1); i <= std::min(count - 1, over + 1); i++)
+    {
+        const point& arc_site = arcs[i];
+        const double arc_weight = weights_of_arcs[i];
+        const double left = breakpoint(i - 1);
+        const double right = breakpoint(i);
+        if (right <= left) //squeezed out, or all of it further out than we look
+        {
+            continue;
+        }
+        double candidates[3] = {left, right, left};
+        //the difference of two arcs is a parabola in x, it peaks at its vertex when the new arc is the narrower one
+        const double site_a = 1.0 / (2*(site.y - y));
+        const double arc_a = 1.0 / (2*(arc_site.y - y));
+        if (site_a < arc_a)
+        {
+            candidates[2] = std::min(std::max((site_a*site.x - arc_a*arc_site.x) / (site_a - arc_a), left), right);
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            const double at = candidates[k];
+            //the neighbours count too, the breakpoints are rounded outwards a little and near them either arc can be on top
+            double beachline_y = calculate_y_parabola(at, arc_site.x, arc_site.y, y, arc_weight);
+            if (i > 0)
+            {
+                beachline_y = std::max(beachline_y, calculate_y_parabola(at, arcs[i-1].x, arcs[i-1].y, y, weights_of_arcs[i-1]));
+            }
+            if (i + 1 < count)
+            {
+                beachline_y = std::max(beachline_y, calculate_y_parabola(at, arcs[i+1].x, arcs[i+1].y, y, weights_of_arcs[i+1]));
+            }
+            const double height = calculate_y_parabola(at, site.x, site.y, y, weight) - beachline_y;
+            if (height > best)
+            {
+                //highest at the end of an arc means it pokes out at the breakpoint, not out of the middle of an arc
+                best = height;
+                arc = i - (k == 0 && i > 0 ? 1 : 0);
+                at_breakpoint = (k == 0 && i > 0) || (k == 1 && i + 1 < count);
+            }
+        }
+    }
+    return best;
+}
+
+//a weighted site is not there yet when the sweepline passes it, its arc starts far behind the beachline and catches up.
+//it comes up when the sweepline reaches its power cell, power_cell_start says when, and the site goes back in the queue
+//for then. a site without a cell never comes up. one that is due but not above the beachline by a rounding error waits
+//in waiting_sites.
+//returns the arc to split in index, or with at_breakpoint the breakpoint after arc index where it comes up (it then
+//starts with a vertex). false when the site is not on the beachline yet
+bool voronoi_diagram::emerge_weighted_site(int& index, bool& at_breakpoint)
+{
+    const point site = current_event.getSite();
+    const double weight = weight_of(site);
+    if (current_event.y == site.y) //the sweepline just passed the site, the next times it is its own queued event
+    {
+        point touch(0, 0);
+        const double start = power_cell_start(site, weight, touch);
+        if (start == std::numeric_limits<double>::infinity())
+        {
+            return false;
+        }
+        current_event.circlePoints[1] = touch; //goes along to the queue and waiting_sites
+        if (start > sweepline.y)
+        {
+            site_event later = current_event;
+            later.y = start;
+            event_queue.insert(later);
+            return false;
+        }
+    }
+    if (weighted_site_peak(site, weight, sweepline.y, current_event.circlePoints[1].x, index, at_breakpoint) > 0.0)
+    {
+        //coming up right at a vertex, the peak can still land a little inside the arc next to it. the sliver of that
+        //arc left on the other side would have its circle event now, which is already behind the sweepline
+        const beachline::arc_list& arcs = beachline.active_arc_sites;
+        const auto vertex_due = [&](const int left, const int right) {
+            if (collinear(arcs[left], arcs[right], site))
+            {
+                return false;
+            }
+            const circle vertex = circumcircle(arcs[left], arcs[right], site, beachline.arc_weights[left], beachline.arc_weights[right], weight);
+            const double time = vertex.center.y + vertex.radius;
+            return time <= sweepline.y && time > sweepline.y - vertex_tolerance * (display_w + display_h);
+        };
+        if (!at_breakpoint && index > 0 && vertex_due(index - 1, index))
+        {
+            index--;
+            at_breakpoint = true;
+        }
+        else if (!at_breakpoint && index + 1 < static_cast<int>(arcs.size()) && vertex_due(index, index + 1))
+        {
+            at_breakpoint = true;
+        }
+        return true;
+    }
+    waiting_sites.push_back(current_event);
+    return false;
+}
+
+//the beachline only changes shape smoothly until the next event, so a waiting site that is above it by then came up
+//somewhere in between. that time is found by bisection and the site goes back in the queue for it. only sites already
+//due by their power cell wait here, normally none or a few
+void voronoi_diagram::schedule_waiting_sites()
+{
+    const double next = !events_left() ? std::max(sweepline.y, static_cast<double>(display_h)) + display_h + display_w : peek_event().y;
+    int arc = 0;
+    bool at_breakpoint = false;
+    for (auto it = waiting_sites.begin(); it != waiting_sites.end();)
+    {
+        const point& site = it->getSite();
+        const double weight = weight_of(site);
+        const double x = it->circlePoints[1].x;
+        if (next > sweepline.y && weighted_site_peak(site, weight, next, x, arc, at_breakpoint) > 0.0)
+        {
+            double below = sweepline.y;
+            double above = next;
+            for (int i = 0; i < 60; i++)
+            {
+                const double middle = below + (above - below) * 0.5;
+                (weighted_site_peak(site, weight, middle, x, arc, at_breakpoint) > 0.0 ? above : below) = middle;
+            }
+            site_event later = *it;
+            later.y = std::max(above, std::nextafter(sweepline.y, next));
+            event_queue.insert(later);
+            it = waiting_sites.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+//when the sweepline first reaches the power cell of site: the least sweep time q.y + sqrt(|q - site|^2 - weight) of a
+//point q of the cell, infinity when the cell is empty. touch is that q, the arc of the site comes up there. the cell
+//starts as a box as wide as weighted_site_peak looks and far up, sites near the top meet their neighbours high above
+//the frame. it is cut by its nearest sites from a kd-tree, and then only by sites that take the point found so far:
+//the time is right once that point is in the cell, the rest of it does not matter. a site on the hull, whose cell
+//reaches the box, so does not need every other site to close it
+double voronoi_diagram::power_cell_start(const point& site, const double weight, point& touch)
+{
+    touch = site;
+    if (weight == 0.0) //one of the heaviest sites, it is in its own cell and comes up when the sweepline passes it
+    {
+        return site.y;
+    }
+    if (power_sites.empty())
+    {
+        for (const point& p : sorted_sites)
+        {
+            if (!(p.y > display_h+1 || p.x > display_w+1 || p.x < -1))
+            {
+                power_sites.push_back(p);
+                power_weights.push_back(weight_of(p));
+            }
+        }
+        power_tree = kd_tree(power_sites);
+        power_site_memory.note(heap_bytes(power_sites) + heap_bytes(power_weights));
+    }
+    const double top = -1e4 * (display_w + display_h);
+    cell c(site);
+    c.polygon = {{-10.0 * display_w, top}, {11.0 * display_w, top}, {11.0 * display_w, 11.0 * display_h}, {-10.0 * display_w, 11.0 * display_h}};
+    c.neighbors = {-1, -1, -1, -1};
+    const int index = power_tree.nearest(site);
+    power_clipped.clear(); //sorted, clipping by the same site twice would leave a zero length side
+    power_tree.nearest(site, std::min<std::size_t>(first_power_neighbors, power_tree.size()), power_nearest);
+    for (const int n : power_nearest)
+    {
+        if (n != index)
+        {
+            clip_cell(c, power_sites[n], n, power_weights[n] - weight);
+            power_clipped.push_back(n);
+        }
+    }
+    std::sort(power_clipped.begin(), power_clipped.end());
+
+    //the sweep time only has a lowest point inside the cell for a weight of 0, so here it is on an edge. along an edge it
+    //is convex: the lowest point is where the line of the edge has it (calculate_emergence on a bisector), or an end
+    const auto sweep_time = [&](const point& q) {
+        return q.y + std::sqrt(std::max(0.0, (q.x - site.x) * (q.x - site.x) + (q.y - site.y) * (q.y - site.y) - weight));
+    };
+    while (c.polygon.size() >= 3)
+    {
+        double start = std::numeric_limits<double>::infinity();
+        point on_edge(0, 0);
+        for (std::size_t i = 0; i < c.polygon.size(); i++)
+        {
+            const point& a = c.polygon[i];
+            const point& b = c.polygon[(i + 1) % c.polygon.size()];
+            if (sweep_time(a) < start)
+            {
+                start = sweep_time(a);
+                touch = a;
+            }
+            const double ex = b.x - a.x;
+            const double ey = b.y - a.y;
+            const double length_squared = ex * ex + ey * ey;
+            if (length_squared == 0.0 || ex == 0.0) //along an upright edge it only goes one way
+            {
+                continue;
+            }
+            double time = 0.0;
+            if (c.neighbors[i] >= 0)
+            {
+                time = calculate_emergence(site, weight, power_sites[c.neighbors[i]], power_weights[c.neighbors[i]], on_edge);
+            }
+            else //a side of the box, at a + u * e the time is a.y + u * e.y + sqrt((u + along)^2 + h^2)
+            {
+                const double length = std::sqrt(length_squared);
+                const double along = ((a.x - site.x) * ex + (a.y - site.y) * ey) / length;
+                const double h = std::sqrt(std::max(0.0, (a.x - site.x) * (a.x - site.x) + (a.y - site.y) * (a.y - site.y) - along * along - weight));
+                const double u = -ey / length * h / std::abs(ex / length) - along;
+                on_edge = point(a.x + ex / length * u, a.y + ey / length * u);
+                time = sweep_time(on_edge);
+            }
+            const double u = ((on_edge.x - a.x) * ex + (on_edge.y - a.y) * ey) / length_squared;
+            if (u > 0.0 && u < 1.0 && time < start)
+            {
+                start = time;
+                touch = on_edge;
+            }
+        }
+        //another site takes touch if |touch - other|^2 - its weight < power. the weights are <= 0, so only sites within
+        //sqrt(power) of it can
+        const double power = (touch.x - site.x) * (touch.x - site.x) + (touch.y - site.y) * (touch.y - site.y) - weight;
+        power_tree.within_radius(touch, std::sqrt(power), power_nearest);
+        const std::size_t before = power_clipped.size();
+        for (const int n : power_nearest)
+        {
+            const point& other = power_sites[n];
+            if (n != index && !std::binary_search(power_clipped.begin(), power_clipped.begin() + before, n) &&
+                (touch.x - other.x) * (touch.x - other.x) + (touch.y - other.y) * (touch.y - other.y) - power_weights[n] < power)
+            {
+                clip_cell(c, other, n, power_weights[n] - weight);
+                power_clipped.push_back(n);
+            }
+        }
+        if (power_clipped.size() == before)
+        {
+            return start;
+        }
+        std::sort(power_clipped.begin(), power_clipped.end());
+    }
+    return std::numeric_limits<double>::infinity();
+}
 
-    for (int i = 0; i < beachline.active_arc_sites.size()-1; i++) {
-        double breakpoint_x = calculate_parabola_intersection(beachline.active_arc_sites.at(i), beachline.active_arc_sites.at(i+1), sweepline.y);
-        double breakpoint_y = calculate_y_parabola(breakpoint_x, beachline.active_arc_sites.at(i).x, beachline.active_arc_sites.at(i).y, sweepline.y);
-        beachline.breakpoints.emplace(breakpoint_x,breakpoint_y); //TODO: finne ut om x-verdier må legges inn i på en annen måte for å gjøre opp for at det skal være et balanced binary tree..
+//a weighted site coming up exactly where the arcs at index and index + 1 meet. the new arc goes in between, which makes
+//that point a vertex: the edge between the two arcs ends there and two new ones start
+void voronoi_diagram::insert_at_breakpoint(const int index)
+{
+    trace_scope scope(tracer, trace_phase::half_edges);
+    beachline::arc_list& arcs = beachline.active_arc_sites;
+    const point site = current_event.getSite();
+    const point left = arcs.at(index);
+    const point right = arcs.at(index + 1);
+    const double site_weight = weight_of(site);
+    const double left_weight = beachline.arc_weights.at(index);
+    const double right_weight = beachline.arc_weights.at(index + 1);
+    if (index > 0)
+    {
+        remove_circle_event(arcs[index - 1], left, right, true);
+    }
+    if (index + 2 < static_cast<int>(arcs.size()))
+    {
+        remove_circle_event(left, right, arcs[index + 2], true);
+    }
+    arcs.insert(arcs.begin() + index + 1, site);
+    beachline.arc_weights.insert(beachline.arc_weights.begin() + index + 1, site_weight);
+    if (index > 0)
+    {
+        add_circle_event(arcs[index - 1], left, site);
+    }
+    if (index + 3 < static_cast<int>(arcs.size()))
+    {
+        add_circle_event(site, right, arcs[index + 3]);
+    }
+
+    const double x = calculate_parabola_intersection(left, right, sweepline.y, left_weight, right_weight);
+    const point vertex(x, calculate_y_parabola(x, left.x, left.y, sweepline.y, left_weight));
+    vertices.push_back(vertex);
+    //the breakpoints move along their edges, a short step of the sweepline gives the directions
+    const double step = 1e-3 * (1 + std::abs(sweepline.y));
+    const auto direction_at = [&](const point& a, const double a_weight, const point& b, const double b_weight, const double y) {
+        const double bx = calculate_parabola_intersection(a, b, y, a_weight, b_weight);
+        vector2D direction(bx - vertex.x, calculate_y_parabola(bx, a.x, a.y, y, a_weight) - vertex.y);
+        direction.normalize();
+        return direction;
+    };
+    const std::pair<point, point> closed(std::min(left, right), std::max(left, right));
+    bool closed_found = false;
+    for (auto it = half_edges.begin(); it != half_edges.end(); ++it)
+    {
+        if (it->arc_sites == closed)
+        {
+            diagram_edges.emplace_back(it->start, vertex, it->arc_sites);
+            half_edges.erase(it);
+            closed_found = true;
+            break;
+        }
+    }
+    if (!closed_found)
+    {
+        half_edges.emplace(vertex, sweepline.y, direction_at(left, left_weight, right, right_weight, sweepline.y - step), closed);
+    }
+    half_edges.emplace(vertex, sweepline.y, direction_at(left, left_weight, site, site_weight, sweepline.y + step), std::make_pair(std::min(left, site), std::max(left, site)));
+    half_edges.emplace(vertex, sweepline.y, direction_at(site, site_weight, right, right_weight, sweepline.y + step), std::make_pair(std::min(site, right), std::max(site, right)));
+}
 
+void voronoi_diagram::update_breakpoints() {
+    trace_scope scope(tracer, trace_phase::update_breakpoints);
+    beachline.breakpoints.clear();
+    const std::size_t arcs = beachline.active_arc_sites.size();
+    if (arcs < 2)
+    {
+        return;
+    }
+    //every breakpoint at once with the batch kernels (geometry_batch.h), y on the left arc of each. they come out left
+    //to right, so each one goes in at the end of the set
+    breakpoint_xs.resize(arcs - 1);
+    breakpoint_ys.resize(arcs - 1);
+    const double* weights_of_arcs = weighted ? beachline.arc_weights.data() : nullptr;
+    parabola_intersections(beachline.active_arc_sites.data(), weights_of_arcs, arcs, sweepline.y, breakpoint_xs.data());
+    arc_ys(beachline.active_arc_sites.data(), weights_of_arcs, breakpoint_xs.data(), arcs - 1, sweepline.y, breakpoint_ys.data());
+    for (std::size_t i = 0; i + 1 < arcs; i++)
+    {
+        beachline.breakpoints.emplace_hint(beachline.breakpoints.end(), breakpoint_xs[i], breakpoint_ys[i]);
     }
 }
 
 void voronoi_diagram::run_next_event()
 {
-    if(!event_queue.empty())
+    trace_scope scope(tracer, trace_phase::event);
+    if(events_left())
     {
         next_site();
         if (!beachline.active_arc_sites.empty())
@@ -355,6 +1093,13 @@ void voronoi_diagram::run_next_event()
             update_breakpoints(); //TODO: Do this in a smarter way, possibly with vectors with len 1 and multiply by height difference or something
         }
         update_beachline();
+        if (!waiting_sites.empty())
+        {
+            schedule_waiting_sites();
+        }
+        events_run++;
+        record_telemetry();
+        note_memory();
     }
     else
     {
@@ -362,12 +1107,123 @@ void voronoi_diagram::run_next_event()
     }
 }
 
-void voronoi_diagram::run_voronoi() {
-    while (!event_queue.empty())
+void voronoi_diagram::run_voronoi()
+{
+    run_voronoi(nullptr);
+}
+
+sweep_progress voronoi_diagram::get_progress() const
+{
+    sweep_progress progress;
+    progress.sites_done = next_sorted_site;
+    progress.sites_total = sorted_sites.size();
+    progress.sweepline_y = sweepline.y;
+    return progress;
+}
+
+bool voronoi_diagram::run_voronoi(const std::function<bool(const sweep_progress&)>& keep_going) {
+    trace_scope scope(tracer, trace_phase::run);
+    if (engine == voronoi_engine::per_cell)
+    {
+        if (keep_going && !keep_going(get_progress()))
+        {
+            return false;
+        }
+        //the cells come first here, the edges are their shared sides. each side is in both cells, the lower index adds it
+        compute_cells(input_points, weights, display_w, display_h, engine_cells);
+        next_sorted_site = sorted_sites.size();
+        event_queue.clear();
+        diagram_edges.clear();
+        vertices.clear();
+        for (std::size_t i = 0; i < engine_cells.size(); i++)
+        {
+            const cell& c = engine_cells[i];
+            for (std::size_t k = 0; k < c.polygon.size(); k++)
+            {
+                const int neighbor = c.neighbors[k];
+                if (neighbor > static_cast<int>(i))
+                {
+                    diagram_edges.emplace_back(c.polygon[k], c.polygon[(k + 1) % c.polygon.size()], std::make_pair(c.site, input_points[neighbor]));
+                }
+            }
+        }
+        std::size_t cell_bytes = heap_bytes(engine_cells);
+        for (const cell& c : engine_cells)
+        {
+            cell_bytes += heap_bytes(c.polygon) + heap_bytes(c.neighbors);
+        }
+        cell_memory.note(cell_bytes);
+        note_memory();
+        return true;
+    }
+    //a diagram has fewer than 3n edges and 2n vertices
+    diagram_edges.reserve(diagram_edges.size() + 3 * sorted_sites.size());
+    vertices.reserve(vertices.size() + 2 * sorted_sites.size());
+    std::size_t events_since_drain = 0;
+    while (events_left())
     {
         run_next_event();
+        //a thousand events leave far fewer spans than a ring holds, emptying it this often drops none
+        if (tracer != nullptr && ++events_since_drain % 1024 == 0)
+        {
+            tracer->drain();
+        }
+        if (keep_going && !keep_going(get_progress()))
+        {
+            return false;
+        }
     }
     complete_edges();
+    return true;
+}
+
+void voronoi_diagram::draw_sites(SDL_Renderer* renderer) const
+{
+    std::vector<SDL_Point> site_points; //every site is drawn as a small plus, five points each
+    site_points.reserve(input_points.size() * 5);
+    for (const point& p : input_points)
+    {
+        const int x = static_cast<int>(p.x);
+        const int y = static_cast<int>(p.y);
+        site_points.push_back({x, y});
+        site_points.push_back({x, y + 1});
+        site_points.push_back({x, y - 1});
+        site_points.push_back({x + 1, y});
+        site_points.push_back({x - 1, y});
+    }
+    SDL_RenderDrawPoints(renderer, site_points.data(), static_cast<int>(site_points.size()));
+}
+
+void voronoi_diagram::draw_edges(SDL_Renderer* renderer, const std::vector<edge>& edges, const std::size_t first)
+{
+    for (std::size_t i = first; i < edges.size(); i++)
+    {
+        const edge& diagram_edge = edges[i];
+        SDL_RenderDrawLine(renderer, static_cast<int>(diagram_edge.start.x),static_cast<int>(diagram_edge.start.y),static_cast<int>(diagram_edge.end.x),static_cast<int>(diagram_edge.end.y));
+    }
+}
+
+void voronoi_diagram::fill_snapshot(sweep_snapshot& snapshot) const
+{
+    snapshot.sweepline_y = sweepline.y;
+    snapshot.active_arc_sites.assign(beachline.active_arc_sites.begin(), beachline.active_arc_sites.end());
+    snapshot.active_arc_weights.assign(beachline.arc_weights.begin(), beachline.arc_weights.end());
+    snapshot.breakpoints.assign(beachline.breakpoints.begin(), beachline.breakpoints.end());
+    snapshot.circle_event_ys.clear();
+    for (const site_event& queued_event : event_queue)
+    {
+        if (queued_event.getIsCircleEvent())
+        {
+            snapshot.circle_event_ys.push_back(queued_event.y);
+        }
+    }
+    snapshot.half_edges.assign(half_edges.begin(), half_edges.end());
+    //edges are only ever appended, and the buffers are reused, so only the edges this buffer has not seen yet are copied
+    snapshot.edges.insert(snapshot.edges.end(), diagram_edges.begin() + static_cast<std::ptrdiff_t>(snapshot.edges.size()), diagram_edges.end());
+    if (telemetry != nullptr)
+    {
+        snapshot.telemetry.assign(telemetry->get_samples().begin(), telemetry->get_samples().end());
+    }
 }
 
 void voronoi_diagram::display_full() {
@@ -387,9 +1243,116 @@ void voronoi_diagram::display_full() {
         return;
     }
 
+    //sites and finished edges never change, they are drawn once into this texture and only new edges are added to it.
+    //every frame then only draws the sweepline, beachline, circle events and open half-edges on top.
+    SDL_Texture* static_layer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, display_w, display_h);
+    bool static_layer_dirty = true;
+    std::size_t drawn_edges = 0;
+
+    std::vector<SDL_Point> beachline_strip; //consecutive beachline segments are joined and drawn with one SDL_RenderDrawLines
+    std::vector<SDL_Rect> event_lines; //circle events and breakpoint lines are axis aligned, so they are drawn as 1px rects in one call
+    std::vector<SDL_Point> graph_points;
+    beachline_strip.reserve(display_w + 1);
+
+    const auto flush_beachline = [&]() {
+        if (beachline_strip.size() > 1)
+        {
+            SDL_RenderDrawLines(renderer, beachline_strip.data(), static_cast<int>(beachline_strip.size()));
+        }
+        beachline_strip.clear();
+    };
+    const auto add_beachline_segment = [&](const int x1, const int y1, const int x2, const int y2) {
+        if (beachline_strip.empty() || beachline_strip.back().x != x1 || beachline_strip.back().y != y1)
+        {
+            flush_beachline();
+            beachline_strip.push_back({x1, y1});
+        }
+        beachline_strip.push_back({x2, y2});
+    };
+
+    //the sweep runs on its own thread and publishes a copy of everything the window draws after each batch of events.
+    //the window only ever reads the newest published copy, so neither side waits on the other.
+    triple_buffer<sweep_snapshot> snapshots;
+    std::atomic<bool> quit{false};
+    std::atomic<bool> paused{false};
+    std::atomic<int> events_per_frame{1};
+    std::atomic<int> step_requests{0};
+    //while paused or done the sweep thread waits on wake for a key, a step or quit instead of going round every frame
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    const auto wake_sweep = [&]() {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        wake.notify_one();
+    };
+    constexpr int max_events_per_frame = 1 << 24; //at this point the frame budget is the only limit
+    const auto frame_interval = std::chrono::microseconds(16667);
+
+    //the telemetry graph (key t) needs samples, the viewer keeps its own when none was set
+    sweep_telemetry viewer_telemetry;
+    sweep_telemetry* const caller_telemetry = telemetry;
+    if (telemetry == nullptr)
+    {
+        telemetry = &viewer_telemetry;
+    }
+    bool show_telemetry = false;
+
+    if (engine == voronoi_engine::per_cell)
+    {
+        run_voronoi(); //nothing to animate, the first snapshot is the whole diagram
+    }
+    fill_snapshot(snapshots.write_buffer());
+    snapshots.publish();
+
+    std::thread sweep_thread([&]() {
+        bool finished = false; //the last snapshot is out, nothing will change any more
+        while (!quit.load(std::memory_order_relaxed))
+        {
+            {
+                std::unique_lock<std::mutex> lock(wake_mutex);
+                wake.wait(lock, [&]() {
+                    return quit.load(std::memory_order_relaxed) || (!finished && (!paused.load(std::memory_order_relaxed) || step_requests.load(std::memory_order_relaxed) > 0));
+                });
+            }
+            if (quit.load(std::memory_order_relaxed))
+            {
+                break;
+            }
+            const auto frame_start = std::chrono::steady_clock::now();
+            const auto budget = std::chrono::duration<double, std::milli>(frame_budget_ms);
+            const bool was_finished = !events_left() && half_edges.empty();
+
+            int events = paused.load(std::memory_order_relaxed) ? 0 : events_per_frame.load(std::memory_order_relaxed);
+            events += step_requests.exchange(0, std::memory_order_relaxed);
+            //run as many events as the speed allows, but stop when the frame budget is used up so snapshots keep coming
+            for (int i = 0; i < events && events_left(); i++)
+            {
+                run_next_event();
+                if (std::chrono::steady_clock::now() - frame_start >= budget)
+                {
+                    break;
+                }
+            }
+            if (!events_left() && !half_edges.empty() && !diagram_edges.empty())
+            {
+                complete_edges();
+            }
+            if (events > 0 && !was_finished)
+            {
+                fill_snapshot(snapshots.write_buffer());
+                snapshots.publish();
+            }
+            finished = !events_left() && (half_edges.empty() || diagram_edges.empty());
+            if (events < max_events_per_frame)
+            {
+                std::this_thread::sleep_until(frame_start + frame_interval);
+            }
+        }
+    });
+
     bool running = true;
     bool next_event = false;
     bool key_c_pressed = false;
+    bool title_dirty = true;
     SDL_Event event;
 
     while (running) {
@@ -398,7 +1361,17 @@ void voronoi_diagram::display_full() {
             if (event.type == SDL_QUIT || event.type == SDL_MOUSEBUTTONDOWN) {
                 running = false;
                 break;
-            } if (event.key.keysym.sym == SDLK_c)
+            }
+            if (event.type == SDL_RENDER_TARGETS_RESET || event.type == SDL_RENDER_DEVICE_RESET)
+            {
+                if (event.type == SDL_RENDER_DEVICE_RESET)
+                {
+                    SDL_DestroyTexture(static_layer);
+                    static_layer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, display_w, display_h);
+                }
+                static_layer_dirty = true;
+            }
+            if (event.key.keysym.sym == SDLK_c)
             {
                 next_event = true;
                 key_c_pressed = true;
@@ -410,111 +1383,166 @@ void voronoi_diagram::display_full() {
                     key_c_pressed = false;
                 }
             }
+            if (event.type == SDL_KEYDOWN)
+            {
+                //space pauses, up/down doubles or halves the number of events run per frame
+                const int speed = events_per_frame.load(std::memory_order_relaxed);
+                if (event.key.keysym.sym == SDLK_SPACE)
+                {
+                    paused.store(!paused.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                    wake_sweep();
+                    title_dirty = true;
+                }
+                else if (event.key.keysym.sym == SDLK_UP && speed < max_events_per_frame)
+                {
+                    events_per_frame.store(speed * 2, std::memory_order_relaxed);
+                    title_dirty = true;
+                }
+                else if (event.key.keysym.sym == SDLK_DOWN && speed > 1)
+                {
+                    events_per_frame.store(speed / 2, std::memory_order_relaxed);
+                    title_dirty = true;
+                }
+                else if (event.key.keysym.sym == SDLK_t)
+                {
+                    show_telemetry = !show_telemetry;
+                }
+            }
+        }
+        if (title_dirty)
+        {
+            const std::string title = "Voronoi - " + (paused.load(std::memory_order_relaxed) ? std::string("paused") : std::to_string(events_per_frame.load(std::memory_order_relaxed)) + " events/frame");
+            SDL_SetWindowTitle(window, title.c_str());
+            title_dirty = false;
         }
         if (next_event && !key_c_pressed)
         {
-            if(!event_queue.empty())
-            {
-                run_next_event();
-            }
+            step_requests.fetch_add(1, std::memory_order_relaxed);
+            wake_sweep();
             next_event = false;
         }
-        if (!event_queue.empty())
+
+        snapshots.update();
+        const sweep_snapshot& frame = snapshots.read_buffer();
+
+        if (static_layer_dirty)
         {
-            run_next_event();
+            SDL_SetRenderTarget(renderer, static_layer);
+            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+            SDL_RenderClear(renderer);
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+            draw_sites(renderer);
+            drawn_edges = 0;
+            static_layer_dirty = false;
         }
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255); // Set the background color to purple
-        SDL_RenderClear(renderer);
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // Set the color to white
-        const int height = static_cast<int>(sweepline.y);
+        if (drawn_edges < frame.edges.size())
+        {
+            SDL_SetRenderTarget(renderer, static_layer);
+            SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255); // Set the color to red
+            draw_edges(renderer, frame.edges, drawn_edges);
+            drawn_edges = frame.edges.size();
+        }
+        SDL_SetRenderTarget(renderer, nullptr);
+        SDL_RenderCopy(renderer, static_layer, nullptr, nullptr);
+
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        const int height = static_cast<int>(frame.sweepline_y);
         SDL_RenderDrawLine(renderer, 1, static_cast<int>(height), 800, static_cast<int>(height)); // Draws a line from (x1, y1) to (x2, y2)
-        //int index = 0;
-        //int iteratorIndex = 0;
-        // Loop over breakpoints in the beachline set using iterators
         //Skal ha en løkke som går gjennom alle breakpointsene, basert på hvilken breakpoint det er skal det bestemme hvilken active arc site som gjelder
         //Skal starte på 0 og slutte på 800
-        auto it = beachline.breakpoints.begin();
+        auto it = frame.breakpoints.begin();
         int index = 0;
         int iteratorIndex = 0;
         double previous_y;
         double current_y;
+        const auto arc_weight = [&](const int arc) {return frame.active_arc_weights.empty() ? 0.0 : frame.active_arc_weights[arc];};
+        event_lines.clear();
         while (index<this->display_w)
         {
-            if(beachline.breakpoints.empty()) {
+            if(frame.breakpoints.empty() || frame.active_arc_sites.empty()) {
                 break;
             }
-            if (index>=it->x)
+            if (it != frame.breakpoints.end() && index>=it->x)
             {
 
-                previous_y = calculate_y_parabola(static_cast<double>(index-1),beachline.active_arc_sites[iteratorIndex].x,beachline.active_arc_sites[iteratorIndex].y, height);
-                while(index>=it->x != (it == beachline.breakpoints.end()))
+                previous_y = calculate_y_parabola(static_cast<double>(index-1),frame.active_arc_sites[iteratorIndex].x,frame.active_arc_sites[iteratorIndex].y, height, arc_weight(iteratorIndex));
+                while(it != frame.breakpoints.end() && index>=it->x)
                 {
                     ++it;
                     iteratorIndex++;
-                    if (it->x < index && it->x > 0)
+                    if (it != frame.breakpoints.end() && it->x < index && it->x > 0)
                     {
-                        SDL_RenderDrawLine(renderer, index, static_cast<int>(previous_y), index, height);
+                        const int top = std::min(static_cast<int>(previous_y), height);
+                        event_lines.push_back({index, top, 1, std::abs(height - static_cast<int>(previous_y)) + 1});
                     }
                 }
-                current_y = calculate_y_parabola(static_cast<double>(index),beachline.active_arc_sites[iteratorIndex].x,beachline.active_arc_sites[iteratorIndex].y, height);
-                SDL_RenderDrawLine(renderer, index-1, static_cast<int>(previous_y), index, static_cast<int>(current_y));
+                if (iteratorIndex >= static_cast<int>(frame.active_arc_sites.size()))
+                {
+                    break;
+                }
+                current_y = calculate_y_parabola(static_cast<double>(index),frame.active_arc_sites[iteratorIndex].x,frame.active_arc_sites[iteratorIndex].y, height, arc_weight(iteratorIndex));
+                add_beachline_segment(index-1, static_cast<int>(previous_y), index, static_cast<int>(current_y));
                 index++;
             } else
             {
-                previous_y = calculate_y_parabola(static_cast<double>(index-1),beachline.active_arc_sites[iteratorIndex].x,beachline.active_arc_sites[iteratorIndex].y, height);
-                current_y = calculate_y_parabola(static_cast<double>(index),beachline.active_arc_sites[iteratorIndex].x,beachline.active_arc_sites[iteratorIndex].y, height);
+                previous_y = calculate_y_parabola(static_cast<double>(index-1),frame.active_arc_sites[iteratorIndex].x,frame.active_arc_sites[iteratorIndex].y, height, arc_weight(iteratorIndex));
+                current_y = calculate_y_parabola(static_cast<double>(index),frame.active_arc_sites[iteratorIndex].x,frame.active_arc_sites[iteratorIndex].y, height, arc_weight(iteratorIndex));
                 if (!(current_y < 0 && previous_y <0) && (current_y < display_h && previous_y < display_h))
                 {
-                    SDL_RenderDrawLine(renderer, index-1, static_cast<int>(previous_y), index, static_cast<int>(current_y));
+                    add_beachline_segment(index-1, static_cast<int>(previous_y), index, static_cast<int>(current_y));
                 }
                 index++;
             }
         }
-        for (const point p : input_points)
+        flush_beachline();
+        SDL_RenderFillRects(renderer, event_lines.data(), static_cast<int>(event_lines.size()));
+
+        event_lines.clear();
+        for (const double circle_event_y : frame.circle_event_ys)
         {
-            SDL_RenderDrawPoint(renderer, static_cast<int>(p.x),static_cast<int>(p.y));
-            SDL_RenderDrawPoint(renderer, static_cast<int>(p.x),static_cast<int>(p.y)+1);
-            SDL_RenderDrawPoint(renderer, static_cast<int>(p.x),static_cast<int>(p.y)-1);
-            SDL_RenderDrawPoint(renderer, static_cast<int>(p.x)+1,static_cast<int>(p.y));
-            SDL_RenderDrawPoint(renderer, static_cast<int>(p.x)-1,static_cast<int>(p.y));
+            event_lines.push_back({0, static_cast<int>(circle_event_y), display_w, 1});
         }
-        if (!event_queue.empty())
+        if (!event_lines.empty())
         {
             SDL_SetRenderDrawColor(renderer, 30, 40, 255, 255);
-            auto iter = event_queue.begin();
-            while (iter !=event_queue.end())
-            {
-                if (iter->getIsCircleEvent())
-                {
-                    SDL_RenderDrawLine(renderer, 0,static_cast<int>(iter->y),display_w,static_cast<int>(iter->y));
-                }
-                ++iter;
-            }
+            SDL_RenderFillRects(renderer, event_lines.data(), static_cast<int>(event_lines.size()));
         }
+
         SDL_SetRenderDrawColor(renderer, 255, 40, 255, 255);
-        if (!half_edges.empty())
+        for (const half_edge& open_edge : frame.half_edges)
         {
-            for (auto iterer = half_edges.begin(); iterer != half_edges.end(); ++it)
-            {
-                SDL_RenderDrawLine(renderer, static_cast<int>(iterer->start.x),static_cast<int>(iterer->start.y),static_cast<int>(iterer->start.x + iterer->direction.x*10),static_cast<int>(iterer->start.y + iterer->direction.y*10));
-                ++iterer;
-            }
+            SDL_RenderDrawLine(renderer, static_cast<int>(open_edge.start.x),static_cast<int>(open_edge.start.y),static_cast<int>(open_edge.start.x + open_edge.direction.x*10),static_cast<int>(open_edge.start.y + open_edge.direction.y*10));
         }
-
-        SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255); // Set the color to red
-        if(!diagram_edges.empty())
+        if (show_telemetry && frame.telemetry.size() > 1)
         {
-            if (event_queue.empty() && !half_edges.empty())
+            //arcs (green) and waiting events (orange) down the left side at the sweepline y they were taken at, the
+            //largest value a quarter of the window wide
+            std::size_t largest = 1;
+            for (const telemetry_sample& sample : frame.telemetry)
             {
-                complete_edges();
+                largest = std::max(largest, std::max(sample.arcs, sample.queued_events));
             }
-            for (const auto & diagram_edge : diagram_edges)
+            const double scale = display_w / 4.0 / static_cast<double>(largest);
+            for (int series = 0; series < 2; series++)
             {
-                SDL_RenderDrawLine(renderer, static_cast<int>(diagram_edge.start.x),static_cast<int>(diagram_edge.start.y),static_cast<int>(diagram_edge.end.x),static_cast<int>(diagram_edge.end.y));
+                graph_points.clear();
+                for (const telemetry_sample& sample : frame.telemetry)
+                {
+                    const std::size_t value = series == 0 ? sample.arcs : sample.queued_events;
+                    graph_points.push_back({static_cast<int>(static_cast<double>(value) * scale), static_cast<int>(sample.sweepline_y)});
+                }
+                SDL_SetRenderDrawColor(renderer, series == 0 ? 0 : 255, series == 0 ? 160 : 140, 0, 255);
+                SDL_RenderDrawLines(renderer, graph_points.data(), static_cast<int>(graph_points.size()));
             }
         }
         SDL_RenderPresent(renderer);
     }
+    quit.store(true);
+    wake_sweep();
+    sweep_thread.join();
+    telemetry = caller_telemetry;
+
+    SDL_DestroyTexture(static_layer);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -553,21 +1581,10 @@ void voronoi_diagram::display_end()
     SDL_RenderClear(renderer);
 
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    for (const point& p : input_points)
-    {
-        SDL_RenderDrawPoint(renderer, static_cast<int>(p.x), static_cast<int>(p.y));
-        SDL_RenderDrawPoint(renderer, static_cast<int>(p.x), static_cast<int>(p.y) + 1);
-        SDL_RenderDrawPoint(renderer, static_cast<int>(p.x), static_cast<int>(p.y) - 1);
-        SDL_RenderDrawPoint(renderer, static_cast<int>(p.x) + 1, static_cast<int>(p.y));
-        SDL_RenderDrawPoint(renderer, static_cast<int>(p.x) - 1, static_cast<int>(p.y));
-    }
+    draw_sites(renderer);
 
     SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-    for (const auto& diagram_edge : diagram_edges)
-    {
-        SDL_RenderDrawLine(renderer, static_cast<int>(diagram_edge.start.x), static_cast<int>(diagram_edge.start.y),
-                           static_cast<int>(diagram_edge.end.x), static_cast<int>(diagram_edge.end.y));
-    }
+    draw_edges(renderer, diagram_edges, 0);
 
     SDL_SetRenderTarget(renderer, nullptr);
 
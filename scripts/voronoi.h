@@ -13,45 +13,163 @@ x varies.
 
 */
 
+#include "kd_tree.h"
+#include "node_pool.h"
+#include "sweep_telemetry.h"
+#include "tracked_allocator.h"
 #include "utilities.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <set>
 #include <ostream>
 
+struct SDL_Renderer;
+class sweep_tracer;
+
+//copy of everything the viewer draws, published by the sweep thread in display_full
+struct sweep_snapshot {
+    double sweepline_y = 0.0;
+    std::vector<point> active_arc_sites;
+    std::vector<double> active_arc_weights; //of active_arc_sites, empty when the sweep is not weighted
+    std::vector<point> breakpoints;
+    std::vector<double> circle_event_ys;
+    std::vector<half_edge> half_edges;
+    std::vector<edge> edges;
+    std::vector<telemetry_sample> telemetry;
+};
+
+//how far run_voronoi has come
+struct sweep_progress {
+    std::size_t sites_done = 0; //site events taken so far
+    std::size_t sites_total = 0;
+    double sweepline_y = 0.0;
+    double fraction() const {return sites_total == 0 ? 1.0 : static_cast<double>(sites_done) / static_cast<double>(sites_total);}
+};
+
 static double sweepline_epsilon = 1e-9;
+static constexpr double vertex_tolerance = 1e-9; //relative to the frame size, how far back emerge_weighted_site looks for a vertex
+
+//how run_voronoi builds the diagram: the fortune sweep, or every cell on its own from a kd-tree (see cell_engine.h)
+enum class voronoi_engine {sweep, per_cell};
 
 class voronoi_diagram {
+    friend class sweep_stepper; //reads the current event and what is new after it
     private:
         std::vector<point> input_points;
         std::size_t num_input_points;
-        std::set<site_event> event_queue; //creates a min-heap
+        tracked_vector<point, memory_tag::sorted_sites> sorted_sites; //site events in sweep order, sorted once up front
+        std::size_t next_sorted_site = 0;
+        //the sets of the sweep take their nodes from a pool each (node_pool.h), freed with the diagram. reset reuses them
+        using event_set = std::set<site_event, std::less<site_event>, pool_allocator<site_event, memory_tag::events>>;
+        using half_edge_set = std::set<half_edge, std::less<half_edge>, pool_allocator<half_edge, memory_tag::half_edges>>;
+        event_set event_queue; //circle events, and weighted sites coming up later than their y
         site_event current_event;
 
-        std::set<half_edge> half_edges;
+        half_edge_set half_edges;
         std::vector<edge> diagram_edges;
         std::vector<point> vertices;
+        tracked_vector<std::pair<point, point>, memory_tag::half_edges> off_frame_neighbors; //sites meeting on an edge complete_edges left out, build_cells still needs them
 
         beachline beachline; //organize breakpoints and active sites from left to right, x=0-> x=100
+        tracked_vector<double, memory_tag::beachline> breakpoint_xs, breakpoint_ys; //scratch of update_breakpoints
         sweepline sweepline;
+        bool weighted = false; //any site with a non zero weight, the sweep then builds the power diagram
+        //weights[i] of input_points[i], moved so the heaviest is 0. empty without weights, only a weighted sweep looks
+        std::vector<double> weights;
+        std::vector<std::pair<point, double>> weight_lookup; //the weights by position (CompareByXY), of equal sites the first
+        //weighted sweeps: the sites next_site takes and a kd-tree of them, built at the first weighted site. a site comes
+        //up when the sweepline reaches its power cell, which the nearest of these give
+        std::vector<point> power_sites;
+        std::vector<double> power_weights;
+        kd_tree power_tree{std::vector<point>{}};
+        std::vector<int> power_nearest, power_clipped; //scratch of power_cell_start
+        tracked_vector<site_event, memory_tag::events> waiting_sites; //weighted sites due by their cell whose arc is not above the beachline yet
         int display_w = 800;
         int display_h = 600;
+        double frame_budget_ms = 12.0; //time display_full may spend on events each frame
+        voronoi_engine engine = voronoi_engine::sweep;
+        std::vector<cell> engine_cells; //cells from the per_cell engine, build_cells hands these out
+        std::vector<int> caller_ids; //input_points[i] is the caller's site caller_ids[i], empty while in the caller's order
+        sweep_tracer* tracer = nullptr; //spans around the phases of the sweep when set, see sweep_trace.h
+        sweep_telemetry* telemetry = nullptr; //gets a sample after every event when set
+        std::uint64_t events_run = 0;
+        std::uint64_t circle_events_added = 0;
+        std::uint64_t circle_events_cancelled = 0;
+        //the vectors get_input_points and the like hand out stay std::vector, these note their blocks after every event
+        capacity_account input_memory{memory_tag::input};
+        capacity_account edge_memory{memory_tag::edges};
+        capacity_account vertex_memory{memory_tag::vertices};
+        capacity_account cell_memory{memory_tag::cells};
+        capacity_account power_site_memory{memory_tag::sorted_sites};
+
+        void draw_sites(SDL_Renderer* renderer) const;
+        static void draw_edges(SDL_Renderer* renderer, const std::vector<edge>& edges, std::size_t first);
+        void fill_snapshot(sweep_snapshot& snapshot) const;
+        bool next_is_queued() const;
+        site_event peek_event() const;
+        void pop_event();
+        void prepare_sites();
+        void prepare_weights();
+        double weight_of(const point& site) const; //0 in a sweep that is not weighted
+        void record_telemetry();
+        void note_memory();
     public:
         voronoi_diagram(); //generates a random voronoi_diagram
         explicit voronoi_diagram(std::vector<point> input_points);
+        voronoi_diagram(std::vector<point> input_points, int width, int height); //sites in [0,width] x [0,height] instead of the window size
+        voronoi_diagram(std::vector<point> input_points, std::vector<double> weights, int width, int height); //the power diagram, see set_weights
+        //starts over with new sites in the same frame. the memory of the last run is kept, so running diagram after
+        //diagram on one object does not allocate once it has seen the largest of them
+        void reset(const std::vector<point>& points);
+        void reset(const point* points, std::size_t count);
+        //power diagram weights, weights[i] for input_points[i]: the distance to a site is |p - site|^2 - weight and heavier
+        //sites get bigger cells, some none at all. missing weights count as 0, all 0 gives the plain diagram. before
+        //run_voronoi, reset drops them
+        void set_weights(std::vector<double> new_weights);
+        bool events_left() const;
         void next_site();
         void add_circle_event(point p1,point p2,point p3, bool ordered);
         void remove_circle_event(point p1,point p2,point p3, bool ordered);
         bool remove_arc_site_at_intersection();
         void generate_half_edges_at_new_site();
+        double weighted_site_peak(const point& site, double weight, double y, double x, int& arc, bool& at_breakpoint) const;
+        bool emerge_weighted_site(int& index, bool& at_breakpoint);
+        void schedule_waiting_sites();
+        double power_cell_start(const point& site, double weight, point& touch);
+        void insert_at_breakpoint(int index);
         void complete_edges();
         void update_circle_event();
         void update_breakpoints();
         void update_beachline();
         void run_next_event();
         void run_voronoi();
+        //run_voronoi calling keep_going after every event. once that returns false the sweep stops where it is and
+        //false is returned. the per_cell engine only asks before it starts
+        bool run_voronoi(const std::function<bool(const sweep_progress&)>& keep_going);
+        sweep_progress get_progress() const;
         void display_full();
         void display_end();
+        std::vector<cell> build_cells() const; //one cell per input point, in input order. empty polygon for skipped sites
+        void build_cells(std::vector<cell>& cells) const; //the same, refilling cells in place so its polygons are reused
+
+        const std::vector<point>& get_input_points() const {return input_points;}
+        const std::vector<double>& get_weights() const {return weights;} //as the sweep uses them, heaviest at 0. empty if all 0
+        const std::vector<edge>& get_diagram_edges() const {return diagram_edges;}
+        const std::vector<point>& get_vertices() const {return vertices;}
+        int get_display_w() const {return display_w;}
+        int get_display_h() const {return display_h;}
+        void set_frame_budget(const double milliseconds) {frame_budget_ms = milliseconds;}
+        void set_frame(const int width, const int height) {display_w = width; display_h = height;} //before run_voronoi
+        void set_tracer(sweep_tracer* new_tracer) {tracer = new_tracer;} //null to stop tracing, the tracer must outlive the runs
+        void set_telemetry(sweep_telemetry* new_telemetry) {telemetry = new_telemetry;} //likewise
+        voronoi_engine get_engine() const {return engine;}
+        void set_engine(const voronoi_engine new_engine) {engine = new_engine;} //before run_voronoi
+        void order_sites_spatially(); //input_points (and so cells) in hilbert order, before run_voronoi
+        int get_caller_id(const std::size_t index) const {return caller_ids.empty() ? static_cast<int>(index) : caller_ids[index];}
+        const std::vector<int>& get_caller_ids() const {return caller_ids;}
 };
 
 
@@ -0,0 +1,282 @@
+#include "weighted_raster.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    constexpr int leaf_size = 16;  //regions this small are shaded pixel by pixel
+    constexpr int task_size = 128; //regions this small are handed to the threads whole
+
+    struct region {
+        int x0, y0, x1, y1; //pixels, half open
+    };
+
+    //the usable sites, as doubles for the culling
+    struct raster_job {
+        weighted_metric metric;
+        double scale_x;
+        double scale_y;
+        std::vector<double> x;
+        std::vector<double> y;
+        std::vector<double> weight;
+        std::vector<std::int32_t> index; //into the caller's sites
+        label_map* map;
+    };
+
+    double weighted_distance(const weighted_metric metric, const double distance, const double weight)
+    {
+        return metric == weighted_metric::multiplicative ? distance / weight : distance - weight;
+    }
+
+    //keeps the sites of parent (positions in job) that can be the nearest for some pixel of r: a site whose distance to
+    //the closest point of r is beyond the furthest point of another site can not win anywhere inside
+    void cull(const raster_job& job, const region& r, const std::vector<std::int32_t>& parent, std::vector<std::int32_t>& kept)
+    {
+        thread_local std::vector<double> nearest;
+        nearest.resize(parent.size());
+        const double left = (r.x0 + 0.5) / job.scale_x;
+        const double right = (r.x1 - 0.5) / job.scale_x;
+        const double top = (r.y0 + 0.5) / job.scale_y;
+        const double bottom = (r.y1 - 0.5) / job.scale_y;
+        double limit = std::numeric_limits<double>::infinity();
+        for (std::size_t k = 0; k < parent.size(); k++)
+        {
+            const std::int32_t i = parent[k];
+            const double near_x = std::max(std::max(left - job.x[i], job.x[i] - right), 0.0);
+            const double near_y = std::max(std::max(top - job.y[i], job.y[i] - bottom), 0.0);
+            const double far_x = std::max(job.x[i] - left, right - job.x[i]);
+            const double far_y = std::max(job.y[i] - top, bottom - job.y[i]);
+            nearest[k] = weighted_distance(job.metric, std::sqrt(near_x * near_x + near_y * near_y), job.weight[i]);
+            limit = std::min(limit, weighted_distance(job.metric, std::sqrt(far_x * far_x + far_y * far_y), job.weight[i]));
+        }
+        //the pixels are worked out in float, a little slack keeps sites that tie with the best one
+        limit += 1e-5 * (std::abs(limit) + 1.0);
+        kept.clear();
+        for (std::size_t k = 0; k < parent.size(); k++)
+        {
+            if (nearest[k] <= limit)
+            {
+                kept.push_back(parent[k]);
+            }
+        }
+    }
+
+    //quarters r until it is no bigger than size and calls leaf(region, sites) on the pieces
+    template<typename Leaf>
+    void subdivide(const raster_job& job, const region& r, const std::vector<std::int32_t>& sites, const int size, const Leaf& leaf)
+    {
+        if (r.x1 - r.x0 <= size && r.y1 - r.y0 <= size)
+        {
+            leaf(r, sites);
+            return;
+        }
+        const int mid_x = r.x1 - r.x0 > size ? (r.x0 + r.x1) / 2 : r.x1;
+        const int mid_y = r.y1 - r.y0 > size ? (r.y0 + r.y1) / 2 : r.y1;
+        const region children[4] = {{r.x0, r.y0, mid_x, mid_y}, {mid_x, r.y0, r.x1, mid_y}, {r.x0, mid_y, mid_x, r.y1}, {mid_x, mid_y, r.x1, r.y1}};
+        std::vector<std::int32_t> kept;
+        for (const region& child : children)
+        {
+            if (child.x0 < child.x1 && child.y0 < child.y1)
+            {
+                cull(job, child, sites, kept);
+                subdivide(job, child, kept, size, leaf);
+            }
+        }
+    }
+
+    //per site constant and value of the metric from the squared distance, in float for the kernels. the multiplicative
+    //one stays squared until the end, which saves the square root per site
+    template<weighted_metric metric> struct kernel;
+
+    template<> struct kernel<weighted_metric::multiplicative> {
+        static float term(const double weight) {return static_cast<float>(1.0 / (weight * weight));}
+        static float value(const float squared, const float term) {return squared * term;}
+        static float distance(const float value) {return std::sqrt(value);}
+#if defined(__AVX2__)
+        static __m256 value(const __m256 squared, const __m256 term) {return _mm256_mul_ps(squared, term);}
+        static __m256 distance(const __m256 value) {return _mm256_sqrt_ps(value);}
+#elif defined(__SSE2__)
+        static __m128 value(const __m128 squared, const __m128 term) {return _mm_mul_ps(squared, term);}
+        static __m128 distance(const __m128 value) {return _mm_sqrt_ps(value);}
+#endif
+    };
+
+    template<> struct kernel<weighted_metric::additive> {
+        static float term(const double weight) {return static_cast<float>(weight);}
+        static float value(const float squared, const float term) {return std::sqrt(squared) - term;}
+        static float distance(const float value) {return value;}
+#if defined(__AVX2__)
+        static __m256 value(const __m256 squared, const __m256 term) {return _mm256_sub_ps(_mm256_sqrt_ps(squared), term);}
+        static __m256 distance(const __m256 value) {return value;}
+#elif defined(__SSE2__)
+        static __m128 value(const __m128 squared, const __m128 term) {return _mm_sub_ps(_mm_sqrt_ps(squared), term);}
+        static __m128 distance(const __m128 value) {return value;}
+#endif
+    };
+
+    //every pixel of r against every site left for it. the sites are copied into float arrays first and the pixels go
+    //8 (AVX2) or 4 (SSE2) at a time, the first site wins ties like in the scalar tail
+    template<weighted_metric metric>
+    void shade(const raster_job& job, const region& r, const std::vector<std::int32_t>& sites)
+    {
+        using k = kernel<metric>;
+        thread_local std::vector<float> site_x, site_y, site_term;
+        thread_local std::vector<std::int32_t> site_label;
+        const std::size_t count = sites.size();
+        site_x.resize(count);
+        site_y.resize(count);
+        site_term.resize(count);
+        site_label.resize(count);
+        for (std::size_t s = 0; s < count; s++)
+        {
+            site_x[s] = static_cast<float>(job.x[sites[s]]);
+            site_y[s] = static_cast<float>(job.y[sites[s]]);
+            site_term[s] = k::term(job.weight[sites[s]]);
+            site_label[s] = job.index[sites[s]];
+        }
+        label_map& map = *job.map;
+        const float step_x = static_cast<float>(1.0 / job.scale_x);
+
+        for (int y = r.y0; y < r.y1; y++)
+        {
+            const float pixel_y = static_cast<float>((y + 0.5) / job.scale_y);
+            float* distance = &map.distances[static_cast<std::size_t>(y) * map.width];
+            std::int32_t* label = &map.labels[static_cast<std::size_t>(y) * map.width];
+            int x = r.x0;
+#if defined(__AVX2__)
+            const __m256 lanes = _mm256_set_ps(7.5f, 6.5f, 5.5f, 4.5f, 3.5f, 2.5f, 1.5f, 0.5f);
+            const __m256 py = _mm256_set1_ps(pixel_y);
+            for (; x + 8 <= r.x1; x += 8)
+            {
+                const __m256 px = _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), lanes), _mm256_set1_ps(step_x));
+                __m256 best = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+                __m256i best_label = _mm256_set1_epi32(-1);
+                for (std::size_t s = 0; s < count; s++)
+                {
+                    const __m256 dx = _mm256_sub_ps(px, _mm256_set1_ps(site_x[s]));
+                    const __m256 dy = _mm256_sub_ps(py, _mm256_set1_ps(site_y[s]));
+                    const __m256 value = k::value(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_set1_ps(site_term[s]));
+                    const __m256 closer = _mm256_cmp_ps(value, best, _CMP_LT_OQ);
+                    best = _mm256_blendv_ps(best, value, closer);
+                    best_label = _mm256_blendv_epi8(best_label, _mm256_set1_epi32(site_label[s]), _mm256_castps_si256(closer));
+                }
+                _mm256_storeu_ps(distance + x, k::distance(best));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(label + x), best_label);
+            }
+#elif defined(__SSE2__)
+            const __m128 lanes = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+            const __m128 py = _mm_set1_ps(pixel_y);
+            for (; x + 4 <= r.x1; x += 4)
+            {
+                const __m128 px = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lanes), _mm_set1_ps(step_x));
+                __m128 best = _mm_set1_ps(std::numeric_limits<float>::infinity());
+                __m128i best_label = _mm_set1_epi32(-1);
+                for (std::size_t s = 0; s < count; s++)
+                {
+                    const __m128 dx = _mm_sub_ps(px, _mm_set1_ps(site_x[s]));
+                    const __m128 dy = _mm_sub_ps(py, _mm_set1_ps(site_y[s]));
+                    const __m128 value = k::value(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_set1_ps(site_term[s]));
+                    const __m128 closer = _mm_cmplt_ps(value, best);
+                    const __m128i closer_mask = _mm_castps_si128(closer);
+                    best = _mm_or_ps(_mm_and_ps(closer, value), _mm_andnot_ps(closer, best));
+                    best_label = _mm_or_si128(_mm_and_si128(closer_mask, _mm_set1_epi32(site_label[s])), _mm_andnot_si128(closer_mask, best_label));
+                }
+                _mm_storeu_ps(distance + x, k::distance(best));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(label + x), best_label);
+            }
+#endif
+            for (; x < r.x1; x++)
+            {
+                const float px = (static_cast<float>(x) + 0.5f) * step_x;
+                float best = std::numeric_limits<float>::infinity();
+                std::int32_t best_label = -1;
+                for (std::size_t s = 0; s < count; s++)
+                {
+                    const float dx = px - site_x[s];
+                    const float dy = pixel_y - site_y[s];
+                    const float value = k::value(dx * dx + dy * dy, site_term[s]);
+                    if (value < best)
+                    {
+                        best = value;
+                        best_label = site_label[s];
+                    }
+                }
+                distance[x] = k::distance(best);
+                label[x] = best_label;
+            }
+        }
+    }
+}
+
+label_map compute_weighted_label_map(const std::vector<point>& sites, const std::vector<double>& weights, const weighted_metric metric,
+                                     const int width, const int height, const double scale_x, const double scale_y)
+{
+    label_map map;
+    if (width <= 0 || height <= 0)
+    {
+        return map;
+    }
+    map.width = width;
+    map.height = height;
+    const std::size_t pixel_count = static_cast<std::size_t>(width) * height;
+    map.labels.assign(pixel_count, -1);
+    map.distances.assign(pixel_count, std::numeric_limits<float>::infinity());
+
+    raster_job job{metric, scale_x, scale_y, {}, {}, {}, {}, &map};
+    for (std::size_t i = 0; i < sites.size(); i++)
+    {
+        const double weight = i < weights.size() ? weights[i] : (metric == weighted_metric::multiplicative ? 1.0 : 0.0);
+        if (metric == weighted_metric::multiplicative && !(weight > 0))
+        {
+            continue;
+        }
+        job.x.push_back(sites[i].x);
+        job.y.push_back(sites[i].y);
+        job.weight.push_back(weight);
+        job.index.push_back(static_cast<std::int32_t>(i));
+    }
+    if (job.index.empty())
+    {
+        return map;
+    }
+
+    //the top of the quadtree on this thread, the regions it ends in are shaded in parallel
+    struct task {
+        region area;
+        std::vector<std::int32_t> sites;
+    };
+    std::vector<task> tasks;
+    std::vector<std::int32_t> all(job.index.size());
+    for (std::size_t i = 0; i < all.size(); i++)
+    {
+        all[i] = static_cast<std::int32_t>(i);
+    }
+    std::vector<std::int32_t> root;
+    cull(job, {0, 0, width, height}, all, root);
+    subdivide(job, {0, 0, width, height}, root, task_size, [&](const region& r, const std::vector<std::int32_t>& kept) {
+        tasks.push_back({r, kept});
+    });
+
+    parallel_for(0, tasks.size(), [&](const std::size_t t) {
+        subdivide(job, tasks[t].area, tasks[t].sites, leaf_size, [&](const region& r, const std::vector<std::int32_t>& kept) {
+            if (metric == weighted_metric::multiplicative)
+            {
+                shade<weighted_metric::multiplicative>(job, r, kept);
+            }
+            else
+            {
+                shade<weighted_metric::additive>(job, r, kept);
+            }
+        });
+    });
+    return map;
+}
@@ -0,0 +1,19 @@
+#pragma once
+//raster diagrams for weighted distances whose cells have curved borders, which the sweep and its straight edges can not
+//represent. the image is split up quadtree style and every region only keeps the sites that can still be the nearest
+//somewhere inside it, so the pixels of a leaf tile are only tested against a handful of sites.
+
+#include "distance_transform.h"
+
+#include <vector>
+
+enum class weighted_metric {
+    multiplicative, //|p - site| / weight, borders are circular arcs. sites with weight <= 0 are left out
+    additive        //|p - site| - weight (apollonius diagram), borders are hyperbola branches
+};
+
+//labels like compute_label_map, distances hold the weighted distance itself (not squared, negative inside an additive
+//site's radius). distances are measured in site units, pixel (x, y) is the point ((x + 0.5) / scale_x, (y + 0.5) / scale_y).
+//weights[i] belongs to sites[i], missing weights count as 1 (multiplicative) or 0 (additive)
+label_map compute_weighted_label_map(const std::vector<point>& sites, const std::vector<double>& weights, weighted_metric metric,
+                                     int width, int height, double scale_x = 1.0, double scale_y = 1.0);